@@ -33,11 +33,15 @@
 #include "libavrdude.h"
 
 #include "tpi.h"
+#include "crc16.h"
 
 FP_UpdateProgress update_progress;
 
 #define DEBUG 0
 
+#define AVR_PAGE_RETRIES 2      // Rewrites of a page that fails verification
+#define AVR_MAXRUN 4096         // Max bytes of a run of pages written in one paged_write() call
+
 /* TPI: returns nonzero if NVM controller busy, 0 if free */
 int avr_tpi_poll_nvmbsy(const PROGRAMMER *pgm) {
   unsigned char cmd;
@@ -290,7 +294,7 @@ rcerror:
  */
 int avr_mem_hiaddr(const AVRMEM * mem)
 {
-  int i, n;
+  int n;
   static int disableffopt;
 
   /* calling once with NULL disables any future trailing-0xff optimisation */
@@ -308,17 +312,9 @@ int avr_mem_hiaddr(const AVRMEM * mem)
 
   /* return the highest non-0xff address regardless of how much
      memory was read */
-  for (i = mem->size-1; i >= 0; i--) {
-    if (mem->buf[i] != 0xff) {
-      n = i+1;
-      if (n & 0x01)
-        return n+1;
-      else
-        return n;
-    }
-  }
+  n = memrnot(mem->buf, 0xff, mem->size) + 1;
 
-  return 0;
+  return n & 1? n+1: n;
 }
 
 
@@ -412,54 +408,30 @@ int avr_read_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, con
     /*
      * the programmer supports a paged mode read
      */
-    int need_read, failure;
-    unsigned int pageaddr;
-    unsigned int npages, nread;
-
-    /* quickly scan number of pages to be written to first */
-    for (pageaddr = 0, npages = 0;
-         pageaddr < (unsigned int) mem->size;
-         pageaddr += mem->page_size) {
-      /* check whether this page must be read */
-      for (i = pageaddr;
-           i < pageaddr + mem->page_size;
-           i++)
-        if (vmem == NULL /* no verify, read everything */ ||
-            (mem->tags[i] & TAG_ALLOCATED) != 0 /* verify, do only
-                                                    read pages that
-                                                    are needed in
-                                                    input file */) {
-          npages++;
-          break;
-        }
-    }
+    int failure, pgsize = mem->page_size, size = mem->size;
+    int pageaddr, npages, nread;
 
-    for (pageaddr = 0, failure = 0, nread = 0;
-         !failure && pageaddr < (unsigned int) mem->size;
-         pageaddr += mem->page_size) {
-      /* check whether this page must be read */
-      for (i = pageaddr, need_read = 0;
-           i < pageaddr + mem->page_size;
-           i++)
-        if (vmem == NULL /* no verify, read everything */ ||
-            (vmem->tags[i] & TAG_ALLOCATED) != 0 /* verify, do only
-                                                    read pages that
-                                                    are needed in
-                                                    input file */) {
-          need_read = 1;
-          break;
-        }
-      if (need_read) {
-        rc = pgm->paged_load(pgm, p, mem, mem->page_size,
-                            pageaddr, mem->page_size);
-        if (rc < 0)
-          /* paged load failed, fall back to byte-at-a-time read below */
-          failure = 1;
-        nread++;
-        report_progress(nread, npages, NULL);
-      } else {
-        pmsg_debug("avr_read_mem(): skipping page %u: no interesting data\n", pageaddr / mem->page_size);
-      }
+    /*
+     * Without vmem read everything; when verifying only read pages that
+     * hold data of the input file
+     */
+    if (vmem == NULL)
+      npages = size/pgsize;
+    else
+      for (pageaddr = avr_mem_next_page(vmem, 0, size, pgsize), npages = 0;
+           pageaddr < size;
+           pageaddr = avr_mem_next_page(vmem, pageaddr + pgsize, size, pgsize))
+        npages++;
+
+    for (pageaddr = vmem? avr_mem_next_page(vmem, 0, size, pgsize): 0, failure = 0, nread = 0;
+         !failure && pageaddr < size;
+         pageaddr = vmem? avr_mem_next_page(vmem, pageaddr + pgsize, size, pgsize): pageaddr + pgsize) {
+      rc = pgm->paged_load(pgm, p, mem, pgsize, pageaddr, pgsize);
+      if (rc < 0)
+        /* paged load failed, fall back to byte-at-a-time read below */
+        failure = 1;
+      nread++;
+      report_progress(nread, npages, NULL);
     }
     if (!failure) {
       led_clr(pgm, LED_PGM);
@@ -918,6 +890,220 @@ int avr_write_byte(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
 }
 
 
+// Does the programmer write memory m page by page in avr_write_mem()?
+static int can_write_paged(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m) {
+  return (pgm->paged_load && m->page_size > 1 && m->size % m->page_size == 0) ||
+    ((pgm->prog_modes & PM_SPM) && avr_has_paged_access(pgm, m));
+}
+
+/*
+ * Read back the page of m at addr into buf and compare the allocated bytes
+ * below vsize with the buffer of m, ignoring read-only locations (counted
+ * in *nrop) and unused bits. Returns the number of mismatches, which are
+ * shown if report is set, or LIBAVRDUDE_GENERAL_FAILURE if reading failed.
+ */
+static int verify_page(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  int addr, int vsize, unsigned char *buf, int report, int *nrop) {
+
+  int n = 0, end = addr + m->page_size < vsize? addr + m->page_size: vsize;
+
+  if(avr_read_page_default(pgm, p, m, addr, buf) < 0)
+    return LIBAVRDUDE_GENERAL_FAILURE;
+  led_set(pgm, LED_PGM);
+
+  for(int i = avr_mem_next_allocated(m, addr, end); i < end; i++) {
+    unsigned char dev = buf[i-addr], in = m->buf[i];
+    uint8_t bitmask = p->prog_modes & PM_ISP? 0xff: avr_mem_bitmask(p, m, i);
+
+    if(!(m->tags[i] & TAG_ALLOCATED) || ((dev ^ in) & bitmask) == 0)
+      continue;
+    if(pgm->readonly && pgm->readonly(pgm, p, m, i)) {
+      (*nrop)++;
+      continue;
+    }
+    if(report && n == 0)
+      pmsg_error("%s page [0x%04x, 0x%04x] fails verification\n", m->desc, addr, addr + m->page_size-1);
+    if(report && n < 10)
+      imsg_error("device 0x%02x != input 0x%02x at addr 0x%04x (error)\n", dev, in, i);
+    n++;
+  }
+
+  return n;
+}
+
+// Write the n bytes at addr of m in one paged_write() call and restore the input bytes from orig
+static int write_run(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  int addr, int n, const uint8_t *orig) {
+
+  int rc = pgm->paged_write(pgm, p, m, m->page_size, addr, n);
+
+  memcpy(m->buf + addr, orig, n);
+
+  return rc < 0? LIBAVRDUDE_SOFTFAIL: 0;
+}
+
+/*
+ * Write the allocated bytes of m below wsize page by page padding holes
+ * with the device contents. If vsize >= 0 each page is read back right
+ * after writing it and, on mismatch, rewritten up to AVR_PAGE_RETRIES times
+ * (after a page erase if the programmer can and the whole page is known);
+ * allocated bytes in pages between the last written one and vsize, eg,
+ * trailing 0xff cut off from the input, are only read back and compared.
+ * Otherwise, programmers that set pgm->paged_max get runs of consecutive
+ * pages in one paged_write() call unless each page needs erasing first.
+ *
+ * Returns 0 on success, LIBAVRDUDE_SOFTFAIL if a paged write failed (so the
+ * caller may fall back to byte writes) and LIBAVRDUDE_GENERAL_FAILURE else.
+ */
+static int write_mem_paged(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  int wsize, int auto_erase, int vsize) {
+
+  int failure, pageaddr, npages, nwritten, nro = 0;
+
+  /*
+   * Not all paged memory looks like NOR memory to AVRDUDE, particularly
+   *  - EEPROM
+   *  - when talking to a bootloader
+   *  - handling write via a part-programmer combo that can do page erase
+   *
+   * Hence, read in from the chip all pages with holes to fill them in. The
+   * small cost of doing so is outweighed by the benefit of not potentially
+   * overwriting bytes with 0xff outside the input file.
+   *
+   * Also consider that the effective page size for *SPM* erasing of parts
+   * can be 4 times the page size for SPM writing (eg, ATtiny1634). Thus
+   * ensure the holes cover the effective page size for SPM programming.
+   * Benefits -c arduino with input files with holes on 4-page-erase parts.
+   */
+
+  // Establish and sanity check effective page size
+  int mpgsize = m->page_size, pgsize = (pgm->prog_modes & PM_SPM) && p->n_page_erase > 0?
+    p->n_page_erase*mpgsize: mpgsize;
+  if((pgsize & (pgsize-1)) || pgsize < 1) {
+    pmsg_error("effective page size %d implausible\n", pgsize);
+    return LIBAVRDUDE_GENERAL_FAILURE;
+  }
+
+  // Length limit of runs of consecutive pages that are written in one go
+  int maxrun = mpgsize;
+  if(pgm->paged_max > mpgsize && vsize < 0 && !(auto_erase && pgm->page_erase))
+    maxrun = (pgm->paged_max < AVR_MAXRUN? pgm->paged_max: AVR_MAXRUN)/mpgsize*mpgsize;
+  int runaddr = 0, runlen = 0;
+
+  // Scratch space for a device page and for the input bytes of the current run
+  uint8_t *spc = cfg_malloc(__func__, mpgsize + maxrun), *orig = spc + mpgsize;
+
+  // Set cwsize as rounded-up wsize
+  int cwsize = (wsize + pgsize-1)/pgsize*pgsize;
+
+  // Quickly scan number of pages to be written to: all pages of effective pages with data
+  for(pageaddr = avr_mem_next_page(m, 0, cwsize, pgsize), npages = 0; pageaddr < cwsize;
+      pageaddr = avr_mem_next_page(m, pageaddr + pgsize, cwsize, pgsize))
+    npages += pgsize/mpgsize;
+
+  // Visit only effective pages with data, padding holes page by page in place
+  for(pageaddr = avr_mem_next_page(m, 0, cwsize, pgsize), failure = 0, nwritten = 0;
+    !failure && pageaddr < cwsize;
+    pageaddr = avr_mem_next_page(m, pageaddr + pgsize, cwsize, pgsize)) {
+
+    for(int addr = pageaddr; !failure && addr < pageaddr + pgsize; addr += mpgsize) {
+      int rc = 0, end = addr + mpgsize, hole = avr_mem_next_hole(m, addr, end), known = 1;
+
+      // Write the current run if this page does not extend it
+      if(runlen && (addr != runaddr + runlen || runlen + mpgsize > maxrun || addr>>16 != runaddr>>16)) {
+        if((failure = write_run(pgm, p, m, runaddr, runlen, orig)))
+          break;
+        report_progress(nwritten += runlen/mpgsize, npages, NULL);
+        runlen = 0;
+      }
+
+      if(hole < end) {          // Memory page has holes
+        // Read flash contents to spc and fill in holes, keeping the input bytes in orig
+        if(avr_read_page_default(pgm, p, m, addr, spc) >= 0) {
+          pmsg_notice2("padding %s [0x%04x, 0x%04x]\n", m->desc, addr, end-1);
+          memcpy(orig + runlen, m->buf + addr, mpgsize);
+          for(int i = hole; i < end; i++)
+            if(!(m->tags[i] & TAG_ALLOCATED))
+              m->buf[i] = spc[i-addr];
+          led_set(pgm, LED_PGM);
+        } else {
+          pmsg_notice2("cannot read %s [0x%04x, 0x%04x] to pad page\n",
+            m->desc, addr, end-1);
+          if(avr_mem_next_allocated(m, addr, end) >= end) // Nothing to write here
+            continue;
+          hole = end;           // Write page as is
+          known = 0;
+        }
+      }
+
+      if(maxrun > mpgsize) {    // Add page to run, which is written later
+        if(hole >= end)
+          memcpy(orig + runlen, m->buf + addr, mpgsize);
+        if(!runlen)
+          runaddr = addr;
+        runlen += mpgsize;
+        continue;
+      }
+
+      if (auto_erase && pgm->page_erase)
+        rc = pgm->page_erase(pgm, p, m, addr);
+      if (rc >= 0)
+        rc = pgm->paged_write(pgm, p, m, mpgsize, addr, mpgsize);
+      if (rc < 0)
+        failure = LIBAVRDUDE_SOFTFAIL;
+
+      // Read back page while its address is fresh and rewrite it on mismatch
+      for(int ntry = 0; !failure && vsize >= 0; ntry++) {
+        int nbad = verify_page(pgm, p, m, addr, vsize, spc, ntry == AVR_PAGE_RETRIES, &nro);
+
+        if(nbad == 0)
+          break;
+        if(nbad < 0 || ntry == AVR_PAGE_RETRIES) {
+          if(nbad < 0)
+            pmsg_error("cannot read back %s page [0x%04x, 0x%04x]\n", m->desc, addr, end-1);
+          failure = LIBAVRDUDE_GENERAL_FAILURE;
+          break;
+        }
+        pmsg_notice("%s page [0x%04x, 0x%04x] fails verification, rewriting it\n", m->desc, addr, end-1);
+        rc = known && pgm->page_erase? pgm->page_erase(pgm, p, m, addr): 0;
+        if(rc < 0 || pgm->paged_write(pgm, p, m, mpgsize, addr, mpgsize) < 0)
+          failure = LIBAVRDUDE_GENERAL_FAILURE;
+      }
+
+      if(hole < end)            // Restore input
+        memcpy(m->buf + addr, orig, mpgsize);
+      nwritten++;
+      report_progress(nwritten, npages, NULL);
+    }
+  }
+
+  if(!failure && runlen) {      // Last run
+    failure = write_run(pgm, p, m, runaddr, runlen, orig);
+    report_progress(nwritten += runlen/mpgsize, npages, NULL);
+  }
+
+  // Input beyond the written pages, eg, cut-off trailing 0xff, is only compared
+  for(int addr = avr_mem_next_page(m, cwsize, vsize, mpgsize); !failure && addr < vsize;
+    addr = avr_mem_next_page(m, addr + mpgsize, vsize, mpgsize)) {
+    int nbad = verify_page(pgm, p, m, addr, vsize, spc, 1, &nro);
+
+    if(nbad != 0) {
+      if(nbad < 0)
+        pmsg_error("cannot read back %s page [0x%04x, 0x%04x]\n", m->desc, addr, addr+mpgsize-1);
+      failure = LIBAVRDUDE_GENERAL_FAILURE;
+    }
+  }
+
+  if(nro && quell_progress < 2)
+    pmsg_warning("ignoring %d mismatch%s in read-only areas of %s%s\n", nro, nro == 1? "": "es",
+      m->desc, mem_is_in_flash(m)? ", expected for vectors and/or bootloader": "");
+
+  free(spc);
+
+  return failure;
+}
+
+
 /*
  * Write the whole memory region of the specified memory from its buffer of
  * the avrpart pointed to by p to the device.  Write up to size bytes from
@@ -1045,126 +1231,16 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
   }
 
   // HW programmers need a page size > 1, bootloader typ only offer paged r/w
-  if ((pgm->paged_load && m->page_size > 1 && m->size % m->page_size == 0) ||
-     ((pgm->prog_modes & PM_SPM) && avr_has_paged_access(pgm, m))) {
-    /*
-     * the programmer supports a paged mode write
-     */
-    int need_write, failure, nset;
-    unsigned int pageaddr;
-    unsigned int npages, nwritten;
+  if (can_write_paged(pgm, p, m)) {
+    int rc = write_mem_paged(pgm, p, m, wsize, auto_erase, -1);
 
-    /*
-     * Not all paged memory looks like NOR memory to AVRDUDE, particularly
-     *  - EEPROM
-     *  - when talking to a bootloader
-     *  - handling write via a part-programmer combo that can do page erase
-     *
-     * Hence, read in from the chip all pages with holes to fill them in. The
-     * small cost of doing so is outweighed by the benefit of not potentially
-     * overwriting bytes with 0xff outside the input file.
-     *
-     * Also consider that the effective page size for *SPM* erasing of parts
-     * can be 4 times the page size for SPM writing (eg, ATtiny1634). Thus
-     * ensure the holes cover the effective page size for SPM programming.
-     * Benefits -c arduino with input files with holes on 4-page-erase parts.
-     */
-
-    AVRMEM *cm = avr_dup_mem(m);
-
-    // Establish and sanity check effective page size
-    int pgsize = (pgm->prog_modes & PM_SPM) && p->n_page_erase > 0?
-      p->n_page_erase*cm->page_size: cm->page_size;
-    if((pgsize & (pgsize-1)) || pgsize < 1) {
-      pmsg_error("effective page size %d implausible\n", pgsize);
-      avr_free_mem(cm);
-      led_set(pgm, LED_ERR);
-      led_clr(pgm, LED_PGM);
-      return LIBAVRDUDE_GENERAL_FAILURE;
-    }
-
-    uint8_t *spc = cfg_malloc(__func__, cm->page_size);
-
-    // Set cwsize as rounded-up wsize
-    int cwsize = (wsize + pgsize-1)/pgsize*pgsize;
-
-    for(pageaddr = 0; pageaddr < (unsigned int) cwsize; pageaddr += pgsize) {
-      for(i = pageaddr, nset = 0; i < pageaddr + pgsize; i++)
-        if(cm->tags[i] & TAG_ALLOCATED)
-          nset++;
-
-      if(nset && nset != pgsize) { // Effective page has holes
-        for(int np=0; np < pgsize/cm->page_size; np++) { // page by page
-          unsigned int beg = pageaddr + np*cm->page_size;
-          unsigned int end = beg + cm->page_size;
-
-          for(i = beg; i < end; i++)
-            if(!(cm->tags[i] & TAG_ALLOCATED))
-              break;
-
-          if(i >= end)          // Memory page has no holes
-             continue;
-
-          // Read flash contents to separate memory spc and fill in holes
-          if(avr_read_page_default(pgm, p, cm, beg, spc) >= 0) {
-            pmsg_notice2("padding %s [0x%04x, 0x%04x]\n", cm->desc, beg, end-1);
-            for(i = beg; i < end; i++)
-              if(!(cm->tags[i] & TAG_ALLOCATED)) {
-                cm->tags[i] |= TAG_ALLOCATED;
-                cm->buf[i] = spc[i-beg];
-              }
-          } else {
-            pmsg_notice2("cannot read %s [0x%04x, 0x%04x] to pad page\n",
-              cm->desc, beg, end-1);
-          }
-        }
-      }
-    }
-
-    // Quickly scan number of pages to be written to
-    for(pageaddr = 0, npages = 0; pageaddr < (unsigned int) cwsize; pageaddr += cm->page_size) {
-      for(i = pageaddr; i < pageaddr + cm->page_size; i++)
-        if(cm->tags[i] & TAG_ALLOCATED) {
-          npages++;
-          break;
-        }
-    }
-
-    for (pageaddr = 0, failure = 0, nwritten = 0;
-      !failure && pageaddr < (unsigned int) cwsize;
-      pageaddr += cm->page_size) {
-
-      // Check whether this page must be written to
-      for (i = pageaddr, need_write = 0; i < pageaddr + cm->page_size; i++)
-        if ((cm->tags[i] & TAG_ALLOCATED) != 0) {
-          need_write = 1;
-          break;
-        }
-
-      if (need_write) {
-        int rc = 0;
-        if (auto_erase && pgm->page_erase)
-          rc = pgm->page_erase(pgm, p, cm, pageaddr);
-        if (rc >= 0)
-          rc = pgm->paged_write(pgm, p, cm, cm->page_size, pageaddr, cm->page_size);
-        if (rc < 0)
-          /* paged write failed, fall back to byte-at-a-time write below */
-          failure = 1;
-        nwritten++;
-        report_progress(nwritten, npages, NULL);
-      } else {
-        pmsg_debug("%s(): skipping page %u: no interesting data\n", __func__, pageaddr / cm->page_size);
-      }
-    }
-
-    avr_free_mem(cm);
-    free(spc);
-
-    if (!failure) {
+    if (rc != LIBAVRDUDE_SOFTFAIL) {
+      if (rc < 0)
+        led_set(pgm, LED_ERR);
       led_clr(pgm, LED_PGM);
-      return wsize;
+      return rc < 0? rc: wsize;
     }
-    /* else: fall back to byte-at-a-time write, for historical reasons */
+    /* else: paged write failed, fall back to byte-at-a-time write, for historical reasons */
   }
 
   // ISP programming from now on; flash will look like NOR-memory
@@ -1226,6 +1302,41 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, int
   return i;
 }
 
+/*
+ * Write memory as avr_write_mem() does but read back each page right after
+ * writing it and rewrite pages that do not match; the allocated bytes below
+ * vsize are verified. This spares a second pass over the memory with fresh
+ * address setup per page. Returns the number of bytes written and verified,
+ * LIBAVRDUDE_GENERAL_FAILURE on error and LIBAVRDUDE_NOTSUPPORTED if the
+ * programmer cannot read and write the memory page by page or the paged
+ * write failed: then the caller is to write and verify it the usual way.
+ */
+int avr_write_verify_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  int size, int auto_erase, int vsize) {
+
+  int rc;
+
+  if(((p->prog_modes & PM_TPI) && pgm->cmd_tpi) || m->page_size < 2 ||
+    !can_write_paged(pgm, p, m) || !avr_has_paged_access(pgm, m))
+    return LIBAVRDUDE_NOTSUPPORTED;
+
+  if(size > m->size)
+    size = m->size;
+  if(vsize > m->size)
+    vsize = m->size;
+  if(size <= 0)
+    return size;
+
+  led_clr(pgm, LED_ERR);
+  led_set(pgm, LED_PGM);
+  rc = write_mem_paged(pgm, p, m, size, auto_erase, vsize < size? size: vsize);
+  if(rc < 0)
+    led_set(pgm, LED_ERR);
+  led_clr(pgm, LED_PGM);
+
+  return rc == LIBAVRDUDE_SOFTFAIL? LIBAVRDUDE_NOTSUPPORTED: rc < 0? rc: size;
+}
+
 
 /*
  * read the AVR device's signature bytes
@@ -1336,45 +1447,50 @@ int avr_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, const
   }
 
   int verror = 0, vroerror = 0, maxerrs = verbose >= MSG_DEBUG? size+1: 10;
-  for (i=0; i<size; i++) {
-    if ((b->tags[i] & TAG_ALLOCATED) != 0 && buf1[i] != buf2[i]) {
-      uint8_t bitmask = p->prog_modes & PM_ISP? get_fuse_bitmask(a): avr_mem_bitmask(p, a, i);
-      if(pgm->readonly && pgm->readonly(pgm, p, a, i)) {
-        if(quell_progress < 2) {
-          if(vroerror < 10) {
+  for (int beg = avr_mem_next_allocated(b, 0, size), end; beg < size; beg = avr_mem_next_allocated(b, end, size)) {
+    end = avr_mem_next_hole(b, beg, size);
+    if (memcmp(buf1+beg, buf2+beg, end-beg) == 0) // Section matches
+      continue;
+    for (i = beg; i < end; i++) {
+      if (buf1[i] != buf2[i]) {
+        uint8_t bitmask = p->prog_modes & PM_ISP? get_fuse_bitmask(a): avr_mem_bitmask(p, a, i);
+        if(pgm->readonly && pgm->readonly(pgm, p, a, i)) {
+          if(quell_progress < 2) {
+            if(vroerror < 10) {
+              if(!(verror + vroerror))
+                pmsg_warning("verification mismatch%s\n",
+                  mem_is_in_flash(a)? " in r/o areas, expected for vectors and/or bootloader": "");
+              imsg_warning("device 0x%02x != input 0x%02x at addr 0x%04x (read only location)\n",
+                buf1[i], buf2[i], i);
+            } else if(vroerror == 10)
+              imsg_warning("suppressing further mismatches in read-only areas\n");
+          }
+          vroerror++;
+        } else if((buf1[i] & bitmask) != (buf2[i] & bitmask)) {
+          // Mismatch is not just in unused bits
+          if(verror < maxerrs) {
             if(!(verror + vroerror))
-              pmsg_warning("verification mismatch%s\n",
-                mem_is_in_flash(a)? " in r/o areas, expected for vectors and/or bootloader": "");
-            imsg_warning("device 0x%02x != input 0x%02x at addr 0x%04x (read only location)\n",
-              buf1[i], buf2[i], i);
-          } else if(vroerror == 10)
-            imsg_warning("suppressing further mismatches in read-only areas\n");
-        }
-        vroerror++;
-      } else if((buf1[i] & bitmask) != (buf2[i] & bitmask)) {
-        // Mismatch is not just in unused bits
-        if(verror < maxerrs) {
-          if(!(verror + vroerror))
-            pmsg_warning("verification mismatch\n");
-          imsg_error("device 0x%02x != input 0x%02x at addr 0x%04x (error)\n", buf1[i], buf2[i], i);
-        } else if(verror == maxerrs) {
-          imsg_warning("suppressing further verification errors\n");
-        }
-        verror++;
-        if(verbose < 1)
-          return -1;
-      } else {
-        // Mismatch is only in unused bits
-        if ((buf1[i] | bitmask) != 0xff) {
-          // Programmer returned unused bits as 0, must be the part/programmer
-          pmsg_warning("ignoring mismatch in unused bits of %s\n", memstr);
-          imsg_warning("(device 0x%02x != input 0x%02x); to prevent this warning fix\n", buf1[i], buf2[i]);
-          imsg_warning("the part or programmer definition in the config file\n");
+              pmsg_warning("verification mismatch\n");
+            imsg_error("device 0x%02x != input 0x%02x at addr 0x%04x (error)\n", buf1[i], buf2[i], i);
+          } else if(verror == maxerrs) {
+            imsg_warning("suppressing further verification errors\n");
+          }
+          verror++;
+          if(verbose < 1)
+            return -1;
         } else {
-          // Programmer returned unused bits as 1, must be the user
-          pmsg_warning("ignoring mismatch in unused bits of %s\n", memstr);
-          imsg_warning("(device 0x%02x != input 0x%02x); to prevent this warning set\n", buf1[i], buf2[i]);
-          imsg_warning("unused bits to 1 when writing (double check with datasheet)\n");
+          // Mismatch is only in unused bits
+          if ((buf1[i] | bitmask) != 0xff) {
+            // Programmer returned unused bits as 0, must be the part/programmer
+            pmsg_warning("ignoring mismatch in unused bits of %s\n", memstr);
+            imsg_warning("(device 0x%02x != input 0x%02x); to prevent this warning fix\n", buf1[i], buf2[i]);
+            imsg_warning("the part or programmer definition in the config file\n");
+          } else {
+            // Programmer returned unused bits as 1, must be the user
+            pmsg_warning("ignoring mismatch in unused bits of %s\n", memstr);
+            imsg_warning("(device 0x%02x != input 0x%02x); to prevent this warning set\n", buf1[i], buf2[i]);
+            imsg_warning("unused bits to 1 when writing (double check with datasheet)\n");
+          }
         }
       }
     }
@@ -1383,6 +1499,85 @@ int avr_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, const
   return verror? -1: size;
 }
 
+// CRCSCAN peripheral of UPDI parts
+#define CRCSCAN_BASE     0x0120
+#define CRCSCAN_CTRLA    0x00
+#define CRCSCAN_CTRLB    0x01
+#define CRCSCAN_STATUS   0x02
+#define CRCSCAN_ENABLE   0x01
+#define CRCSCAN_RESET    0x80
+#define CRCSCAN_SRC_FLASH 0x00
+#define CRCSCAN_BUSY     0x01
+#define CRCSCAN_OK       0x02
+#define CRCSCAN_TIMEOUT  1000   // ms
+
+/*
+ * Verify flash of a UPDI part on the target using its CRCSCAN peripheral.
+ * CRCSCAN does not expose the CRC itself but only flags whether the
+ * CRC-16-CCITT over the whole flash, including a big-endian checksum in the
+ * last two bytes, is zero. Hence this can only confirm images that carry
+ * such a checksum: the host computes the CRC over the flash as expected
+ * from the memory buffer of p (unallocated bytes read 0xff) and only asks
+ * the target when that is zero. Parts configured for CRC-32 are skipped.
+ *
+ * As any self-checking image passes the scan, the caller must ensure the
+ * flash was erased and then written from m in this session, so that the
+ * check is against write errors rather than against a different image;
+ * programmers drop their flash-erased flag once a write revisits flash
+ * that was already written since the erase.
+ *
+ * Return 1 if the target confirmed the flash contents, 0 if the caller
+ * needs to read back and compare, and -1 on communication errors.
+ */
+int avr_crcscan_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m) {
+  const AVRMEM *io = avr_locate_io(p);
+  const Configitem_t *cfg;
+  int nc, crcsel = 0;
+
+  if(!(p->prog_modes & PM_UPDI) || !mem_is_flash(m) || !io || io->size <= CRCSCAN_BASE+CRCSCAN_STATUS)
+    return 0;
+
+  if((cfg = avr_locate_configitems(p, &nc)) && avr_locate_config(cfg, nc, "crcsel", str_eq) &&
+    avr_get_config_value(pgm, p, "crcsel", &crcsel) == 0 && crcsel) {
+    pmsg_notice("CRCSCAN set to CRC-32, verifying by read-back\n");
+    return 0;
+  }
+
+  unsigned short crc = 0xffff;
+  unsigned char ff = 0xff;
+  for(int i = 0; i < m->size; i++)
+    crc = crcccitt(m->tags[i] & TAG_ALLOCATED? m->buf+i: &ff, 1, crc);
+  if(crc) {
+    pmsg_notice("%s image does not end in a CRCSCAN checksum, verifying by read-back\n", m->desc);
+    return 0;
+  }
+
+  unsigned char status = 0;
+  if(pgm->write_byte(pgm, p, io, CRCSCAN_BASE+CRCSCAN_CTRLA, CRCSCAN_RESET) < 0 ||
+    pgm->write_byte(pgm, p, io, CRCSCAN_BASE+CRCSCAN_CTRLB, CRCSCAN_SRC_FLASH) < 0 ||
+    pgm->write_byte(pgm, p, io, CRCSCAN_BASE+CRCSCAN_CTRLA, CRCSCAN_ENABLE) < 0)
+    return -1;
+
+  uint64_t start = avr_mstimestamp();
+  do {
+    if(pgm->read_byte(pgm, p, io, CRCSCAN_BASE+CRCSCAN_STATUS, &status) < 0)
+      return -1;
+  } while((status & CRCSCAN_BUSY) && avr_mstimestamp() - start < CRCSCAN_TIMEOUT);
+
+  pgm->write_byte(pgm, p, io, CRCSCAN_BASE+CRCSCAN_CTRLA, CRCSCAN_RESET);
+
+  if(status & CRCSCAN_BUSY) {
+    pmsg_notice("CRCSCAN timed out, verifying by read-back\n");
+    return 0;
+  }
+  if(!(status & CRCSCAN_OK)) {
+    pmsg_notice("CRCSCAN reports a %s mismatch, verifying by read-back\n", m->desc);
+    return 0;
+  }
+
+  return 1;
+}
+
 
 int avr_get_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int *cycles) {
   AVRMEM * a;
@@ -39,6 +39,9 @@
  * int avr_write_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const
  *  AVRMEM *mem, unsigned long addr, unsigned char data);
  *
+ * int avr_prefetch_cached(const PROGRAMMER *pgm, const AVRPART *p, const
+ *  AVRMEM *mem, int addr, int len);
+ *
  * int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p);
  *
  * int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p);
@@ -48,6 +51,11 @@
  *
  * int avr_reset_cache(const PROGRAMMER *pgm, const AVRPART *p);
  *
+ * void avr_forget_byte_cache(const PROGRAMMER *pgm);
+ *
+ * int avr_write_mem_diff(const PROGRAMMER *pgm, const AVRPART *p, const
+ *  AVRMEM *mem, int size, const AVRMEM *img, int *npagesp);
+ *
  * avr_read_byte_cached() and avr_write_byte_cached() use a cache if paged
  * routines are available and if the device memory is flash, EEPROM, bootrow
  * or usersig. The AVRXMEGA memories application, apptable and boot are
@@ -61,8 +69,24 @@
  * avr_flush_cache() or when attempting to read or write from a location
  * outside the address range of the device memory.
  *
+ * Small memories without paged access that do not change under the running
+ * part, ie, fuses, lock and the read-only memories such as signature,
+ * calibration or sigrow, are cached byte by byte: each byte is read from
+ * the device only once. Writes to them go straight to the device and, as
+ * memories may overlap (eg, fuses and fuse0) and a write may change other
+ * bytes, make the cache forget all small memories; so do chip erase and
+ * avr_forget_byte_cache(). SRAM and I/O registers are volatile and never
+ * cached.
+ *
+ * On a cache miss, programmers that set pgm->paged_max get the missing page
+ * and the pages after it read in one paged_load() call. The number of pages
+ * read ahead doubles with each miss of the page directly after the last one
+ * read. avr_prefetch_cached() loads a known address range into the cache
+ * ahead of bytewise access, eg, for terminal dumps.
+ *
  * avr_flush_cache() synchronises pending writes to flash, EEPROM, bootrow
- * and usersig with the device. With some programmer and part combinations,
+ * and usersig with the device, writing runs of modified pages with one
+ * paged_write() call where pgm->paged_max allows. With some programmer and part combinations,
  * flash (and sometimes EEPROM, too) looks like a NOR memory, ie, a write can
  * only clear bits, never set them. For NOR memories a page erase or, if not
  * available, a chip erase needs to be issued before writing arbitrary data.
@@ -95,8 +119,19 @@
  * The avr_page_erase_cached() function erases a page and synchronises it
  * with the cache.
  *
+ * avr_write_mem_diff() is the differential counterpart of avr_write_mem():
+ * it reads into the cache every page of the device memory that holds
+ * allocated input data, copies the input over the cached contents and then
+ * flushes the cache, so that only pages that actually differ are erased (if
+ * needed) and written. Unallocated bytes in a page keep their device contents.
+ * An optional device image img, which must have been confirmed beforehand,
+ * spares reading those pages whose input bytes img knows to be on the device;
+ * pages that img knows in full are taken from img rather than read, so that
+ * a complete reference image (-R) needs no device reads other than the
+ * read-back of written pages.
+ *
  * Finally, avr_reset_cache() resets the cache without synchronising pending
- * writes() to the device.
+ * writes() to the device and forgets the cached small memories.
  *
  * This file also holds the following utility functions
  *
@@ -213,11 +248,7 @@ int avr_write_page_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
 
 // Could memory region s1 be the result of a NOR-memory copy of s3 onto s2?
 int avr_is_and(const unsigned char *s1, const unsigned char *s2, const unsigned char *s3, size_t n) {
-    while(n--)
-        if(*s1++ != (*s2++ & *s3++))
-            return 0;
-
-    return 1;
+    return memisand(s1, s2, s3, n);
 }
 
 
@@ -238,13 +269,65 @@ static int cacheAddress(int addr, const AVR_Cache *cp, const AVRMEM *mem) {
 }
 
 
-static int loadCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int addr, int cacheaddr, int nlOnErr) {
+#define CACHE_MAXRUN 4096       // Max bytes read ahead or written back in one paged call
+
+// Number of pages from mem address addr on that one paged_load()/paged_write() call may cover
+static int maxRunPages(const PROGRAMMER *pgm, const AVRMEM *mem, int addr) {
+    int pgsize = mem->page_size, max = pgm->paged_max < CACHE_MAXRUN? pgm->paged_max: CACHE_MAXRUN;
+    int end = (addr | 0xffff) + 1; // Don't cross 64 kB boundaries (extended addresses)
+
+    if(end > mem->size)
+        end = mem->size;
+    if(end - addr < max)
+        max = end - addr;
+
+    return pgsize > 1 && max >= 2*pgsize? max/pgsize: 1;
+}
+
+
+/*
+ * Read n pages from mem address addr on into buf with one paged_load() call
+ * falling back to page-wise reads; mem is unaffected (though temporarily changed)
+ */
+static int readCachePages(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int addr, int n, unsigned char *buf) {
+    int pgsize = mem->page_size, nbytes = n*pgsize, rc = LIBAVRDUDE_GENERAL_FAILURE;
+
+    if(n > 1) {
+        led_clr(pgm, LED_ERR);
+        led_set(pgm, LED_PGM);
+        unsigned char *save = cfg_malloc(__func__, nbytes);
+        memcpy(save, mem->buf + addr, nbytes);
+        if((rc = pgm->paged_load(pgm, p, mem, pgsize, addr, nbytes)) >= 0)
+            memcpy(buf, mem->buf + addr, nbytes);
+        memcpy(mem->buf + addr, save, nbytes);
+        free(save);
+        led_clr(pgm, LED_PGM);
+        if(rc >= 0)
+            return rc;
+    }
+
+    for(int i = 0; i < n; i++)
+        if((rc = avr_read_page_default(pgm, p, mem, addr + i*pgsize, buf + i*pgsize)) < 0)
+            break;
+
+    return rc;
+}
+
+
+// Load the page containing addr and up to npages-1 uncached pages after it into the cache
+static int loadCachePages(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+  int addr, int cacheaddr, int npages, int nlOnErr) {
+
     int pgno = cacheaddr/cp->page_size;
 
     if(!cp->iscached[pgno]) {
         // Read cached section from device
-        int cachebase = cacheaddr & ~(cp->page_size-1);
-        if(avr_read_page_default(pgm, p, mem, addr & ~(cp->page_size-1), cp->cont + cachebase) < 0) {
+        int cachebase = cacheaddr & ~(cp->page_size-1), base = addr & ~(cp->page_size-1), n = 1;
+        int max = maxRunPages(pgm, mem, base);
+
+        while(n < npages && n < max && !cp->iscached[pgno+n])
+            n++;
+        if(readCachePages(pgm, p, mem, base, n, cp->cont + cachebase) < 0) {
             report_progress(1, -1, NULL);
             if(nlOnErr && quell_progress)
                 msg_info("\n");
@@ -252,15 +335,29 @@ static int loadCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p,
             return LIBAVRDUDE_GENERAL_FAILURE;
         }
 
-        // Copy last read device page, so we can later check for changes
-        memcpy(cp->copy + cachebase, cp->cont + cachebase, cp->page_size);
-        cp->iscached[pgno] = 1;
+        // Copy last read device pages, so we can later check for changes
+        memcpy(cp->copy + cachebase, cp->cont + cachebase, n*cp->page_size);
+        memset(cp->iscached + pgno, 1, n);
+        cp->nextpg = pgno + n;
     }
 
     return LIBAVRDUDE_SUCCESS;
 }
 
 
+// Load the page containing addr reading ahead more pages the longer misses are sequential
+static int loadCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int addr, int cacheaddr, int nlOnErr) {
+    int pgno = cacheaddr/cp->page_size;
+
+    if(cp->iscached[pgno])
+        return LIBAVRDUDE_SUCCESS;
+
+    cp->nahead = pgno != cp->nextpg || cp->nahead < 1? 1: cp->nahead < CACHE_MAXRUN? 2*cp->nahead: cp->nahead;
+
+    return loadCachePages(cp, pgm, p, mem, addr, cacheaddr, cp->nahead, nlOnErr);
+}
+
+
 static int initCache(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p) {
     AVRMEM *basemem = cp == pgm->cp_flash? avr_locate_flash(p): cp == pgm->cp_eeprom? avr_locate_eeprom(p):
                                                                 cp == pgm->cp_bootrow? avr_locate_bootrow(p): avr_locate_usersig(p);
@@ -330,10 +427,49 @@ static int writeCachePage(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p
 }
 
 
+/*
+ * Write n modified pages from base on to the device with one paged_write()
+ * call and read them back into the copy; fall back to writeCachePage() for
+ * each page if there is only one or that paged_write() failed
+ */
+static int writeCachePages(AVR_Cache *cp, const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int base, int n, int nlOnErr) {
+    int pgsize = cp->page_size, nbytes = n*pgsize, rc = LIBAVRDUDE_GENERAL_FAILURE;
+
+    if(n > 1) {
+        led_clr(pgm, LED_ERR);
+        led_set(pgm, LED_PGM);
+        unsigned char *save = cfg_malloc(__func__, nbytes);
+        memcpy(save, mem->buf + base, nbytes);
+        memcpy(mem->buf + base, cp->cont + base, nbytes);
+        rc = pgm->paged_write(pgm, p, mem, pgsize, base, nbytes);
+        memcpy(mem->buf + base, save, nbytes);
+        free(save);
+        // Read pages back from device and update copy to what is on device
+        if(rc >= 0 && readCachePages(pgm, p, mem, base, n, cp->copy + base) < 0) {
+            report_progress(1, -1, NULL);
+            if(nlOnErr && quell_progress)
+                msg_info("\n");
+            pmsg_error("unable to read %s pages at addr 0x%04x\n", mem->desc, base);
+            led_set(pgm, LED_ERR);
+            led_clr(pgm, LED_PGM);
+            return LIBAVRDUDE_GENERAL_FAILURE;
+        }
+        led_clr(pgm, LED_PGM);
+        if(rc >= 0)
+            return LIBAVRDUDE_SUCCESS;
+    }
+
+    for(int i = 0; i < n; i++)
+        if(writeCachePage(cp, pgm, p, mem, base + i*pgsize, nlOnErr) < 0)
+            return LIBAVRDUDE_GENERAL_FAILURE;
+
+    return LIBAVRDUDE_SUCCESS;
+}
+
+
 // Does the memory region only haxe 0xff?
 static int _is_all_0xff(const void *p, size_t n) {
-    const unsigned char *q = (const unsigned char *) p;
-    return n <= 0 || (*q == 0xff && memcmp(q, q+1, n-1) == 0);
+    return memall(p, 0xff, n);
 }
 
 
@@ -491,9 +627,10 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
 
                 for(int ird = 0, pgno = 0, n = 0; n < cp->size; pgno++, n += cp->page_size) {
                     if(!cp->iscached[pgno]) {
-                        report_progress(ird++, nrd, NULL);
-                        if(loadCachePage(cp, pgm, p, mem, n, n, 1) < 0)
+                        report_progress(ird, nrd, NULL);
+                        if(loadCachePages(cp, pgm, p, mem, n, n, cp->size/cp->page_size, 1) < 0)
                             return LIBAVRDUDE_GENERAL_FAILURE;
+                        ird += cp->nextpg - pgno;
                     }
                 }
             }
@@ -580,20 +717,31 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
             if(!mem || !cp->cont)
                 continue;
 
-            for(int iwr = 0, pgno = 0, n = 0; n < cp->size; pgno++, n += cp->page_size) {
-                if(cp->iscached[pgno] && memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
+            int pgsize = cp->page_size;
+            for(int iwr = 0, pgno = 0, n = 0; n < cp->size; pgno++, n += pgsize) {
+                if(cp->iscached[pgno] && memcmp(cp->copy + n, cp->cont + n, pgsize)) {
+                    // Coalesce directly following modified pages into one run
+                    int run = 1, max = maxRunPages(pgm, mem, n);
+                    while(run < max && cp->iscached[pgno+run] &&
+                        memcmp(cp->copy + n + run*pgsize, cp->cont + n + run*pgsize, pgsize))
+                        run++;
+
                     if(!chiperase && mems[i].pgerase && pgm->page_erase)
-                        led_page_erase(pgm, p, mem, n);
-                    if(writeCachePage(cp, pgm, p, mem, n, 1) < 0)
-                        return LIBAVRDUDE_GENERAL_FAILURE;
-                    if(memcmp(cp->copy + n, cp->cont + n, cp->page_size)) {
-                        report_progress(1, -1, NULL);
-                        if(quell_progress)
-                            msg_info("\n");
-                        pmsg_error("verification mismatch at %s page addr 0x%04x\n", mem->desc, n);
+                        for(int k = 0; k < run; k++)
+                            led_page_erase(pgm, p, mem, n + k*pgsize);
+                    if(writeCachePages(cp, pgm, p, mem, n, run, 1) < 0)
                         return LIBAVRDUDE_GENERAL_FAILURE;
+                    for(int k = 0; k < run; k++, pgno++, n += pgsize) {
+                        if(memcmp(cp->copy + n, cp->cont + n, pgsize)) {
+                            report_progress(1, -1, NULL);
+                            if(quell_progress)
+                                msg_info("\n");
+                            pmsg_error("verification mismatch at %s page addr 0x%04x\n", mem->desc, n);
+                            return LIBAVRDUDE_GENERAL_FAILURE;
+                        }
+                        report_progress(iwr++, nwr, NULL);
                     }
-                    report_progress(iwr++, nwr, NULL);
+                    pgno--, n -= pgsize; // Loop increments to the page after the run
                 }
             }
         }
@@ -605,9 +753,51 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
 }
 
 
+// Is mem a small memory cached byte by byte in pgm->cp_bytes?
+static int isByteCached(const PROGRAMMER *pgm, const AVRMEM *mem) {
+    return mem->size > 0 && !mem_is_io(mem) && !mem_is_sram(mem) && !avr_has_paged_access(pgm, mem) &&
+        (mem_is_in_fuses(mem) || mem_is_lock(mem) || mem_is_readonly(mem));
+}
+
+/*
+ * Return the location of byte addr of mem in the byte cache, which holds
+ * all byte-cached memories of the part back to back; initialise the cache
+ * if needed. Returns -1 if mem is not byte-cached or addr out of range.
+ */
+static int byteCacheAddress(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, unsigned long addr) {
+    AVR_Cache *cp = pgm->cp_bytes;
+    int size = 0, base = -1;
+
+    if(!isByteCached(pgm, mem) || addr >= (unsigned long) mem->size)
+        return -1;
+
+    for(LNODEID ln = lfirst(p->mem); ln; ln = lnext(ln)) {
+        const AVRMEM *m = ldata(ln);
+        if(isByteCached(pgm, m)) {
+            if(base < 0 && str_eq(m->desc, mem->desc))
+                base = size;
+            size += m->size;
+        }
+    }
+    if(base < 0)
+        return -1;
+
+    if(!cp->cont) {               // Init cache if needed
+        cp->size = size;
+        cp->page_size = 1;
+        cp->cont = cfg_malloc("byteCacheAddress()", cp->size);
+        cp->iscached = cfg_malloc("byteCacheAddress()", cp->size);
+    } else if(cp->size != size)   // Should never happen (unless the part changed)
+        return -1;
+
+    return base + (int) addr;
+}
+
+
 /*
  * Read byte via a read/write cache
  *  - Used if paged routines available and if memory is flash, EEPROM, bootrow or usersig
+ *  - Fuses, lock and read-only memories are read via pgm->read_byte() once into the byte cache
  *  - Otherwise fall back to pgm->read_byte()
  *  - Out of memory addr: synchronise cache and, if successful, pretend reading a zero
  *  - Cache is automagically created and initialised if needed
@@ -615,9 +805,21 @@ int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p) {
 int avr_read_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
                          unsigned long addr, unsigned char *value) {
 
-    // Use pgm->read_byte() if not flash/EEPROM/bootrow/usersig or no paged access
-    if(!avr_has_paged_access(pgm, mem))
-        return fallback_read_byte(pgm, p, mem, addr, value);
+    // Use byte cache or pgm->read_byte() if not flash/EEPROM/bootrow/usersig or no paged access
+    if(!avr_has_paged_access(pgm, mem)) {
+        AVR_Cache *cp = pgm->cp_bytes;
+        int rc, cacheaddr = byteCacheAddress(pgm, p, mem, addr);
+
+        if(cacheaddr < 0)
+            return fallback_read_byte(pgm, p, mem, addr, value);
+        if(!cp->iscached[cacheaddr]) {
+            if((rc = fallback_read_byte(pgm, p, mem, addr, cp->cont + cacheaddr)) < 0)
+                return rc;
+            cp->iscached[cacheaddr] = 1;
+        }
+        *value = cp->cont[cacheaddr];
+        return LIBAVRDUDE_SUCCESS;
+    }
 
     // If address is out of range synchronise cache and, if successful, pretend reading a zero
     if(addr >= (unsigned long) mem->size) {
@@ -648,10 +850,45 @@ int avr_read_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *
 }
 
 
+/*
+ * Load the pages of [addr, addr+len) of mem into the cache in as few paged
+ * reads as possible; does nothing for memories that are not cached
+ */
+int avr_prefetch_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int addr, int len) {
+    if(pgm->read_byte_cached != avr_read_byte_cached || !avr_has_paged_access(pgm, mem))
+        return LIBAVRDUDE_SUCCESS;
+
+    if(addr < 0)
+        addr = 0;
+    if(len > mem->size - addr)
+        len = mem->size - addr;
+    if(len <= 0)
+        return LIBAVRDUDE_SUCCESS;
+
+    AVR_Cache *cp = mem_is_eeprom(mem)? pgm->cp_eeprom: mem_is_in_flash(mem)? pgm->cp_flash:
+                                                        mem_is_bootrow(mem)? pgm->cp_bootrow: pgm->cp_usersig;
+
+    if(!cp->cont)                 // Init cache if needed
+        if(initCache(cp, pgm, p) < 0)
+            return LIBAVRDUDE_GENERAL_FAILURE;
+
+    int pgsize = cp->page_size, end = addr + len;
+    for(addr &= ~(pgsize-1); addr < end; addr += pgsize) {
+        int cacheaddr = cacheAddress(addr, cp, mem);
+        if(cacheaddr < 0)
+            return LIBAVRDUDE_GENERAL_FAILURE;
+        if(loadCachePages(cp, pgm, p, mem, addr, cacheaddr, (end - addr + pgsize-1)/pgsize, 0) < 0)
+            return LIBAVRDUDE_GENERAL_FAILURE;
+    }
+
+    return LIBAVRDUDE_SUCCESS;
+}
+
+
 /*
  * Write byte via a read/write cache
  *  - Used if paged routines available and if memory is flash, EEPROM, bootrow or usersig
- *  - Otherwise fall back to pgm->write_byte()
+ *  - Otherwise fall back to pgm->write_byte() and forget the byte cache
  *  - Out of memory addr: synchronise cache with device and return whether successful
  *  - If programmer indicates a readonly spot, return LIBAVRDUDE_SOFTFAIL
  *  - Cache is automagically created and initialised if needed
@@ -660,8 +897,11 @@ int avr_write_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
                           unsigned long addr, unsigned char data) {
 
     // Use pgm->write_byte() if not flash/EEPROM/bootrow/usersig or no paged access
-    if(!avr_has_paged_access(pgm, mem))
-        return fallback_write_byte(pgm, p, mem, addr, data);
+    if(!avr_has_paged_access(pgm, mem)) {
+        int rc = fallback_write_byte(pgm, p, mem, addr, data);
+        avr_forget_byte_cache(pgm);
+        return rc;
+    }
 
     // If address is out of range synchronise caches with device and return whether successful
     if(addr >= (unsigned long) mem->size)
@@ -705,6 +945,7 @@ int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p) {
 
     if((rc = led_chip_erase(pgm, p)) < 0)
         return rc;
+    avr_forget_byte_cache(pgm);   // Chip erase can clear lock bits
 
     for(size_t i = 0; i < sizeof mems/sizeof*mems; i++) {
         AVRMEM *mem = mems[i].mem;
@@ -795,9 +1036,114 @@ int avr_page_erase_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM
 }
 
 
+// Does avr_write_mem_diff() need to read the page at pageaddr from the device?
+static int diffNeedsRead(const AVRMEM *mem, const AVRMEM *img, int pageaddr, int size) {
+    int end = pageaddr + mem->page_size > size? size: pageaddr + mem->page_size;
+
+    if(avr_mem_next_allocated(mem, pageaddr, end) >= end) // No input data in page
+        return 0;
+
+    return !img || (!avr_devimage_agrees(img, mem, pageaddr, end) &&
+        !memall(img->tags + pageaddr, TAG_ALLOCATED, mem->page_size));
+}
+
+
+/*
+ * Differential write of the allocated bytes among the first size bytes of
+ * mem via the cache
+ *  - Only pages with allocated bytes are read from the device and compared
+ *  - Pages whose allocated bytes agree with a device image img are not read
+ *  - Changed pages that img knows in full are not read either
+ *  - Only pages that differ are written; avr_flush_cache() reads them back
+ *  - Bytes the programmer declares as readonly are left as on the device
+ *  - Returns the number of pages written or a negative error code
+ *  - *npagesp (if not NULL) is set to the number of pages compared
+ */
+int avr_write_mem_diff(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int size,
+  const AVRMEM *img, int *npagesp) {
+    int pgsize = mem->page_size, npages = 0, nchanged = 0, nro = 0;
+
+    if(npagesp)
+        *npagesp = 0;
+
+    if(!avr_has_paged_access(pgm, mem))
+        return LIBAVRDUDE_NOTSUPPORTED;
+
+    if(size < 0 || size > mem->size)
+        size = mem->size;
+
+    // Sync pending writes and forget cached pages, so comparisons are against the device
+    if(avr_flush_cache(pgm, p) < 0)
+        return LIBAVRDUDE_GENERAL_FAILURE;
+
+    AVR_Cache *cp = mem_is_eeprom(mem)? pgm->cp_eeprom: mem_is_in_flash(mem)? pgm->cp_flash:
+                                                        mem_is_bootrow(mem)? pgm->cp_bootrow: pgm->cp_usersig;
+
+    if(!cp->cont) {               // Init cache if needed
+        if(initCache(cp, pgm, p) < 0)
+            return LIBAVRDUDE_GENERAL_FAILURE;
+    } else
+        memset(cp->iscached, 0, cp->size/cp->page_size);
+
+    int base = cacheAddress(0, cp, mem);
+    if(base < 0)
+        return LIBAVRDUDE_GENERAL_FAILURE;
+
+    for(int pageaddr = avr_mem_next_page(mem, 0, size, pgsize); pageaddr < size;
+      pageaddr = avr_mem_next_page(mem, pageaddr + pgsize, size, pgsize))
+        npages++;
+
+    report_progress(0, 1, img? "Comparing": "Reading");
+    for(int pageaddr = avr_mem_next_page(mem, 0, size, pgsize), ird = 0; pageaddr < size;
+      pageaddr = avr_mem_next_page(mem, pageaddr + pgsize, size, pgsize)) {
+
+        report_progress(ird++, npages, NULL);
+        int end = pageaddr + pgsize > size? size: pageaddr + pgsize;
+        if(img && avr_devimage_agrees(img, mem, pageaddr, end))
+            continue;
+        if(img && memall(img->tags + pageaddr, TAG_ALLOCATED, pgsize)) { // Page known: no need to read
+            memcpy(cp->cont + base + pageaddr, img->buf + pageaddr, pgsize);
+            memcpy(cp->copy + base + pageaddr, img->buf + pageaddr, pgsize);
+            cp->iscached[(base + pageaddr)/pgsize] = 1;
+        } else {                  // Read this and directly following pages to be read in one go
+            int n = 1;
+            while(pageaddr + n*pgsize < size && diffNeedsRead(mem, img, pageaddr + n*pgsize, size))
+                n++;
+            if(loadCachePages(cp, pgm, p, mem, pageaddr, base + pageaddr, n, 1) < 0)
+                return LIBAVRDUDE_GENERAL_FAILURE;
+        }
+
+        unsigned char *cont = cp->cont + base + pageaddr;
+        for(int i = avr_mem_next_allocated(mem, pageaddr, end); i < end; i++) {
+            if(!(mem->tags[i] & TAG_ALLOCATED) || cont[i-pageaddr] == mem->buf[i])
+                continue;
+            if(pgm->readonly && pgm->readonly(pgm, p, mem, i)) {
+                nro++;
+                continue;
+            }
+            cont[i-pageaddr] = mem->buf[i];
+        }
+        if(memcmp(cont, cp->copy + base + pageaddr, pgsize))
+            nchanged++;
+    }
+    report_progress(1, 1, NULL);
+
+    if(nro)
+        pmsg_warning("left %d byte%s unchanged in read-only %s area\n", nro, str_plural(nro), mem->desc);
+
+    if(nchanged && avr_flush_cache(pgm, p) < 0)
+        return LIBAVRDUDE_GENERAL_FAILURE;
+
+    if(npagesp)
+        *npagesp = npages;
+
+    return nchanged;
+}
+
+
 // Free cache(s) discarding any pending writes
 int avr_reset_cache(const PROGRAMMER *pgm, const AVRPART *p_unused) {
-    AVR_Cache *mems[] = { pgm->cp_flash, pgm->cp_eeprom, pgm->cp_bootrow, pgm->cp_usersig };
+    AVR_Cache *mems[] = { pgm->cp_flash, pgm->cp_eeprom, pgm->cp_bootrow, pgm->cp_usersig, pgm->cp_bytes };
 
     for(size_t i = 0; i < sizeof mems/sizeof*mems; i++) {
         AVR_Cache *cp = mems[i];
@@ -811,4 +1157,13 @@ int avr_reset_cache(const PROGRAMMER *pgm, const AVRPART *p_unused) {
     }
 
     return LIBAVRDUDE_SUCCESS;
-}
\ No newline at end of file
+}
+
+
+// Forget the cached small memories, eg, after raw commands might have changed fuses
+void avr_forget_byte_cache(const PROGRAMMER *pgm) {
+    AVR_Cache *cp = pgm->cp_bytes;
+
+    if(cp && cp->iscached)
+        memset(cp->iscached, 0, cp->size);
+}
@@ -386,6 +386,67 @@ void avr_free_memalias(AVRMEM_ALIAS *m) {
   mmt_free(m);
 }
 
+/*
+ * Iterators over the allocation tags of a memory: they skip unallocated
+ * (or allocated) stretches eight tags at a time, so that loops over pages or
+ * sections of sparse input cost little compared to scanning byte by byte
+ */
+#define TAGS_ALLOC8 (TAG_ALLOCATED * 0x0101010101010101ULL)
+
+// Return first address in [addr, end) that is allocated in mem, or end if none
+int avr_mem_next_allocated(const AVRMEM *mem, int addr, int end) {
+  if(!mem->tags)
+    return end;
+  if(end > mem->size)
+    end = mem->size;
+
+  for(; addr < end && (addr & 7); addr++)
+    if(mem->tags[addr] & TAG_ALLOCATED)
+      return addr;
+  for(uint64_t w; addr + 8 <= end; addr += 8) {
+    memcpy(&w, mem->tags + addr, 8);
+    if(w & TAGS_ALLOC8)
+      break;
+  }
+  for(; addr < end; addr++)
+    if(mem->tags[addr] & TAG_ALLOCATED)
+      return addr;
+
+  return end;
+}
+
+// Return first address in [addr, end) that is not allocated in mem, or end if none
+int avr_mem_next_hole(const AVRMEM *mem, int addr, int end) {
+  if(!mem->tags)
+    return addr < end? addr: end;
+  if(end > mem->size)
+    end = mem->size;
+
+  for(; addr < end && (addr & 7); addr++)
+    if(!(mem->tags[addr] & TAG_ALLOCATED))
+      return addr;
+  for(uint64_t w; addr + 8 <= end; addr += 8) {
+    memcpy(&w, mem->tags + addr, 8);
+    if((w & TAGS_ALLOC8) != TAGS_ALLOC8)
+      break;
+  }
+  for(; addr < end; addr++)
+    if(!(mem->tags[addr] & TAG_ALLOCATED))
+      return addr;
+
+  return end;
+}
+
+// Return the address of the first page at or after pageaddr with allocated bytes, or end
+int avr_mem_next_page(const AVRMEM *mem, int pageaddr, int end, int pgsize) {
+  int addr = avr_mem_next_allocated(mem, pageaddr, end);
+
+  if(pgsize < 1)
+    pgsize = 1;
+
+  return addr >= end? end: addr - addr % pgsize;
+}
+
 AVRMEM_ALIAS *avr_locate_memalias(const AVRPART *p, const char *desc) {
   AVRMEM_ALIAS *m, *match;
   LNODEID ln;
@@ -81,3 +81,19 @@ crcappend(unsigned char* message, unsigned long length)
   message[length] = (unsigned char)(crc & 0xff);
   message[length+1] = (unsigned char)((crc >> 8) & 0xff);
 }
+
+unsigned short
+crcccitt(const unsigned char* message, unsigned long length,
+	 unsigned short crc)
+{
+  unsigned long i;
+  int b;
+
+  for(i = 0; i < length; i++)
+    {
+      crc ^= message[i] << 8;
+      for(b = 0; b < 8; b++)
+	crc = crc & 0x8000? (crc << 1) ^ 0x1021: crc << 1;
+    }
+  return crc;
+}
@@ -27,6 +27,14 @@ extern int crcverify(const unsigned char* message,
 extern void crcappend(unsigned char* message,
 		      unsigned long length);
 
+/*
+ * Non-reflected CRC-16-CCITT (polynomial 0x1021) as computed by the
+ * CRCSCAN peripheral of UPDI parts; start with crc = 0xffff.
+ */
+extern unsigned short crcccitt(const unsigned char* message,
+			       unsigned long length,
+			       unsigned short crc);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,292 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2026 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* $Id$ */
+
+/*
+ * Host-side device image cache
+ *
+ * With -k each -U write records what has been written to a memory of an
+ * individual device in an image file under $XDG_CACHE_HOME/avrdude (or
+ * ~/.cache/avrdude; %LOCALAPPDATA%\avrdude on Windows). A device is known
+ * by part, signature and a device id, which is the one that the programmer
+ * provides through pgm->device_id() (eg, the urclock ID), else the contents
+ * of the sernum memory of the part, else the USB serial number given with
+ * -P usb:<sn>. Without device id there is no image cache.
+ *
+ * Differential writes (-U mem:d:file) do not read pages of the device whose
+ * contents the image already knows, and verify (-U mem:v:file) succeeds
+ * without full read-back when the image already holds the file contents.
+ * In either case, a few pages spread over the file contents are read from
+ * the device first and compared with the image: if any of them disagree,
+ * the image is deemed outdated and the device read as usual. An image is
+ * only recorded after the write was verified, by read-back or on-target CRC.
+ *
+ * Images are only kept for flash. Firmware routinely changes EEPROM, and a
+ * few sampled pages cannot vouch for the rest of it. A firmware that writes
+ * its own flash can equally make the image stale in pages that the sample
+ * misses, so -k is meant for devices whose flash only avrdude changes.
+ * Writes to memories within flash, eg, application or boot, remove the
+ * flash image.
+ *
+ * Image file format: the 4-byte magic "ADI1", the memory size as 4-byte
+ * little endian number, that many bytes of memory contents and the same
+ * number of bytes of tags; a byte is known when its tag has TAG_ALLOCATED.
+ */
+
+#include <ac_cfg.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(WIN32)
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#define DEVIMAGE_MAGIC "ADI1"
+#define DEVIMAGE_NSAMPLES 4     // Number of pages read to confirm an image
+
+static char *devimage_dir(void) {
+#if defined(WIN32)
+  const char *base = getenv("LOCALAPPDATA");
+  return base && *base? str_sprintf("%s\\avrdude", base): NULL;
+#else
+  const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+  return xdg && *xdg? str_sprintf("%s/avrdude", xdg):
+    home && *home? str_sprintf("%s/.cache/avrdude", home): NULL;
+#endif
+}
+
+// Put a device id as printable string into id[n]; return -1 if none known
+static int devimage_id(const PROGRAMMER *pgm, const AVRPART *p, char *id, size_t n) {
+  const AVRMEM *m;
+
+  if(pgm->device_id && pgm->device_id(pgm, p, id, n) >= 0 && *id)
+    return 0;
+
+  if((m = avr_locate_sernum(p)) && m->size > 0 && (size_t) 2*m->size < n && pgm->read_byte) {
+    unsigned char c, and = 0xff, or = 0;
+    int i;
+    for(i = 0; i < m->size; i++) {
+      if(led_read_byte(pgm, p, m, i, &c) < 0)
+        break;
+      and &= c, or |= c;
+      sprintf(id + 2*i, "%02x", c);
+    }
+    if(i == m->size && and != 0xff && or != 0) // Erased or zero serial numbers don't count
+      return 0;
+  }
+
+  if(pgm->usbsn && *pgm->usbsn && strlen(pgm->usbsn) < n) {
+    strcpy(id, pgm->usbsn);
+    return 0;
+  }
+
+  return -1;
+}
+
+// Path of the image file for mem (or NULL), creating the directory if asked to
+static char *devimage_path(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int create) {
+  char id[128], *dir, *path;
+
+  if(!mem_is_flash(mem) || devimage_id(pgm, p, id, sizeof id) < 0)
+    return NULL;
+  for(char *s = id; *s; s++)
+    if(!(*s >= '0' && *s <= '9') && !(*s >= 'a' && *s <= 'z') && !(*s >= 'A' && *s <= 'Z') && *s != '-')
+      *s = '_';
+
+  if(!(dir = devimage_dir()))
+    return NULL;
+
+  if(create)                    // Make dir and any missing parents
+    for(char *s = dir+1; ; s++)
+      if(*s == '/' || *s == '\\' || !*s) {
+        char c = *s;
+        *s = 0;
+        if(mkdir(dir, 0777) < 0 && errno != EEXIST) {
+          pmsg_warning("cannot create device image directory %s: %s\n", dir, strerror(errno));
+          mmt_free(dir);
+          return NULL;
+        }
+        if(!(*s = c))
+          break;
+      }
+
+  path = str_sprintf("%s/%s-%02x%02x%02x-%s.%s", dir, p->id,
+    p->signature[0], p->signature[1], p->signature[2], id, mem->desc);
+  mmt_free(dir);
+
+  return path;
+}
+
+// Load the device image of mem; returns NULL if there is none
+AVRMEM *avr_devimage_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem) {
+  char *path = devimage_path(pgm, p, mem, 0);
+  unsigned char hdr[8];
+  AVRMEM *img = NULL;
+  FILE *fp;
+
+  if(!path)
+    return NULL;
+
+  if((fp = fopen(path, "rb"))) {
+    if(fread(hdr, 1, 8, fp) == 8 && !memcmp(hdr, DEVIMAGE_MAGIC, 4) &&
+      (hdr[4] | hdr[5]<<8 | hdr[6]<<16 | (unsigned) hdr[7]<<24) == (unsigned) mem->size) {
+      img = avr_dup_mem(mem);
+      if(fread(img->buf, 1, img->size, fp) != (size_t) img->size ||
+        fread(img->tags, 1, img->size, fp) != (size_t) img->size) {
+        avr_free_mem(img);
+        img = NULL;
+      }
+    }
+    if(!img)
+      pmsg_warning("ignoring malformed device image %s\n", path);
+    else
+      pmsg_notice("using device image %s\n", path);
+    fclose(fp);
+  }
+  mmt_free(path);
+
+  return img;
+}
+
+/*
+ * Record the allocated bytes of mem as the device contents; if old is not
+ * NULL then keep what it knows about bytes that mem does not allocate
+ */
+int avr_devimage_save(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRMEM *old) {
+  char *path = devimage_path(pgm, p, mem, 1), *tmp;
+  unsigned char hdr[8] = DEVIMAGE_MAGIC, *buf, *tags;
+  int ret = -1;
+  FILE *fp;
+
+  if(!path) {
+    if(mem_is_in_flash(mem))    // Eg, application: the flash image no longer holds
+      avr_devimage_forget(pgm, p, mem);
+    return -1;
+  }
+
+  buf = mmt_malloc(mem->size);
+  tags = mmt_malloc(mem->size);
+  for(int i = 0; i < mem->size; i++) {
+    tags[i] = mem->tags[i] & TAG_ALLOCATED;
+    buf[i] = tags[i]? mem->buf[i]: 0xff;
+    if(!tags[i] && old && old->size == mem->size && (old->tags[i] & TAG_ALLOCATED))
+      tags[i] = TAG_ALLOCATED, buf[i] = old->buf[i];
+  }
+  hdr[4] = mem->size, hdr[5] = mem->size >> 8, hdr[6] = mem->size >> 16, hdr[7] = mem->size >> 24;
+
+  // Write to a temporary file first so that an interrupted run leaves no truncated image
+  tmp = str_sprintf("%s.tmp", path);
+  if((fp = fopen(tmp, "wb"))) {
+    if(fwrite(hdr, 1, 8, fp) == 8 && fwrite(buf, 1, mem->size, fp) == (size_t) mem->size &&
+      fwrite(tags, 1, mem->size, fp) == (size_t) mem->size)
+      ret = 0;
+    if(fclose(fp) != 0)
+      ret = -1;
+    remove(path);
+    if(ret == 0 && rename(tmp, path) < 0)
+      ret = -1;
+  }
+  if(ret < 0) {
+    pmsg_warning("cannot write device image %s: %s\n", path, strerror(errno));
+    remove(tmp);
+  } else
+    pmsg_notice("recorded device image %s\n", path);
+
+  mmt_free(tmp);
+  mmt_free(buf);
+  mmt_free(tags);
+  mmt_free(path);
+
+  return ret;
+}
+
+// Remove the device image of mem (of flash if mem is within), eg, before writing it or after a chip erase
+void avr_devimage_forget(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem) {
+  const AVRMEM *flm = mem_is_in_flash(mem)? avr_locate_flash(p): NULL;
+  char *path = devimage_path(pgm, p, flm? flm: mem, 0);
+
+  if(path) {
+    remove(path);
+    mmt_free(path);
+  }
+}
+
+// Does img know all allocated bytes of mem in [beg, end) and do they agree?
+int avr_devimage_agrees(const AVRMEM *img, const AVRMEM *mem, int beg, int end) {
+  for(int i = avr_mem_next_allocated(mem, beg, end); i < end; i++)
+    if((mem->tags[i] & TAG_ALLOCATED) && (!(img->tags[i] & TAG_ALLOCATED) || img->buf[i] != mem->buf[i]))
+      return 0;
+
+  return 1;
+}
+
+/*
+ * Read up to DEVIMAGE_NSAMPLES pages spread over the pages that hold
+ * allocated bytes of mem in [0, size) and compare them with what img knows.
+ * Returns the number of pages read if all agree, 0 if not and < 0 on error.
+ */
+int avr_devimage_sample(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRMEM *img, int size) {
+  int pgsize = mem->page_size, npages = 0, nsamples, ns, k;
+  unsigned char *page;
+
+  if(!avr_has_paged_access(pgm, mem) || img->size != mem->size)
+    return 0;
+
+  if(size < 0 || size > mem->size)
+    size = mem->size;
+  for(int addr = avr_mem_next_page(mem, 0, size, pgsize); addr < size;
+    addr = avr_mem_next_page(mem, addr + pgsize, size, pgsize))
+    npages++;
+  if(!npages)
+    return 0;
+
+  nsamples = npages < DEVIMAGE_NSAMPLES? npages: DEVIMAGE_NSAMPLES;
+  page = mmt_malloc(pgsize);
+  ns = k = 0;
+  for(int addr = avr_mem_next_page(mem, 0, size, pgsize); addr < size && ns < nsamples;
+    addr = avr_mem_next_page(mem, addr + pgsize, size, pgsize), k++) {
+
+    // Sample pages number 0, ..., npages-1 evenly, including first and last
+    if(k != (nsamples == 1? 0: ns*(npages-1)/(nsamples-1)))
+      continue;
+    if(avr_read_page_default(pgm, p, mem, addr, page) < 0) {
+      mmt_free(page);
+      return LIBAVRDUDE_GENERAL_FAILURE;
+    }
+    for(int i = 0; i < pgsize; i++)
+      if((img->tags[addr+i] & TAG_ALLOCATED) && img->buf[addr+i] != page[i]) {
+        pmsg_notice("device image disagrees with %s at 0x%04x\n", mem->desc, addr+i);
+        mmt_free(page);
+        return 0;
+      }
+    ns++;
+  }
+  mmt_free(page);
+
+  return ns;
+}
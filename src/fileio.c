@@ -252,7 +252,27 @@ static int b2ihex(const unsigned char *buf, const Segment_t *segp, Segorder_t wh
 }
 
 
-static int ihex_readrec(struct ihexsrec *ihex, char * rec) {
+static int hexdigit(int c) {
+  return c >= '0' && c <= '9'? c - '0': c >= 'a' && c <= 'f'? c - 'a' + 10: c >= 'A' && c <= 'F'? c - 'A' + 10: -1;
+}
+
+// Value of the two hex digits at s or -1 if either is not a hex digit
+static int hexbyte(const char *s) {
+  int hi = hexdigit(s[0]), lo = hexdigit(s[1]);
+
+  return hi < 0 || lo < 0? -1: hi << 4 | lo;
+}
+
+// Low byte of the two characters at s read by strtoul(), which also allows blanks and signs; -1 if invalid
+static int strtoulbyte(const char *s) {
+  char buf[3] = { s[0], s[1], 0 }, *e;
+  unsigned long v = strtoul(buf, &e, 16);
+
+  return e == buf || *e != 0? -1: (int) (v & 0xff);
+}
+
+// Decode an Intel Hex record field by field with strtoul() as ihex_readrec() fallback
+static int ihex_readrec_strtoul(struct ihexsrec *ihex, char * rec) {
   int i, j;
   char buf[8];
   int offset, len;
@@ -325,6 +345,47 @@ static int ihex_readrec(struct ihexsrec *ihex, char * rec) {
   return rc;
 }
 
+/*
+ * Decode an Intel Hex record; return -1 if it is malformed, else the
+ * computed checksum. Decodes pairs of hex digits directly as this runs for
+ * every byte of the input file; other than hex digits, eg, blanks or signs,
+ * leave the record to the slower ihex_readrec_strtoul() as ever before.
+ */
+static int ihex_readrec(struct ihexsrec *ihex, char * rec) {
+  int j, hi, lo, typ, c;
+  int len;
+  unsigned char cksum;
+  const char *r = rec+1;
+
+  len = strlen(rec);
+
+  /* reclen, load offset and record type */
+  if (len < 1+2+4+2)
+    return -1;
+  if ((c = hexbyte(r)) < 0 || (hi = hexbyte(r+2)) < 0 || (lo = hexbyte(r+4)) < 0 || (typ = hexbyte(r+6)) < 0)
+    return ihex_readrec_strtoul(ihex, rec);
+  r += 8;
+  ihex->reclen = c;
+  ihex->loadofs = hi << 8 | lo;
+  ihex->rectyp = typ;
+  cksum = c + hi + lo + typ;
+
+  /* data and cksum */
+  if (len < 1+2+4+2 + 2*ihex->reclen + 2)
+    return -1;
+  for (j=0; j<ihex->reclen; j++, r += 2) {
+    if ((c = hexbyte(r)) < 0)
+      return ihex_readrec_strtoul(ihex, rec);
+    ihex->data[j] = c;
+    cksum += c;
+  }
+  if ((c = hexbyte(r)) < 0)
+    return ihex_readrec_strtoul(ihex, rec);
+  ihex->cksum = c;
+
+  return -cksum & 0x000000ff;
+}
+
 
 
 /*
@@ -394,10 +455,8 @@ static int ihex2b(const char *infile, FILE *inf, const AVRMEM *mem,
           free(buffer);
           return -1;
         }
-        for(int i=0; i<ihex.reclen; i++) {
-          mem->buf[nextaddr+i] = ihex.data[i];
-          mem->tags[nextaddr+i] = TAG_ALLOCATED;
-        }
+        memcpy(mem->buf+nextaddr, ihex.data, ihex.reclen);
+        memset(mem->tags+nextaddr, TAG_ALLOCATED, ihex.reclen);
         if (nextaddr+ihex.reclen > maxaddr)
           maxaddr = nextaddr+ihex.reclen;
         break;
@@ -581,16 +640,11 @@ static int srec_readrec(struct ihexsrec *srec, char *rec) {
     cksum += (srec->loadofs >> (i - 1) * 8) & 0xff;
 
   /* data */
-  for (j=0; j<srec->reclen; j++) {
-    if (offset+2  > len) 
-      return -1;
-    for (i=0; i<2; i++) 
-      buf[i] = rec[offset++];
-    buf[i] = 0;
-    srec->data[j] = strtoul(buf, &e, 16);
-    if (e == buf || *e != 0) 
+  for (j=0; j<srec->reclen; j++, offset += 2) {
+    if (offset+2  > len || ((rc = hexbyte(rec+offset)) < 0 && (rc = strtoulbyte(rec+offset)) < 0))
       return -1;
-    cksum += srec->data[j];
+    srec->data[j] = rc;
+    cksum += rc;
   }
 
   /* cksum */
@@ -707,10 +761,8 @@ static int srec2b(const char *infile, FILE * inf,
         free(buffer);
         return -1;
       }
-      for(int i=0; i<srec.reclen; i++) {
-        mem->buf[nextaddr+i] = srec.data[i];
-        mem->tags[nextaddr+i] = TAG_ALLOCATED;
-      }
+      memcpy(mem->buf+nextaddr, srec.data, srec.reclen);
+      memset(mem->tags+nextaddr, TAG_ALLOCATED, srec.reclen);
       if (nextaddr+srec.reclen > maxaddr)
         maxaddr = nextaddr+srec.reclen;
       reccount++;      
@@ -53,6 +53,12 @@
 /*
  * Private data for this programmer.
  */
+#define JTAGMKII_MAX_PIPELINE   16 // Maximum number of jtag2updi page writes in flight
+
+// jtag2updi page write timeouts: computed first wait, then fixed retries
+#define JTAG2UPDI_TRIES          3
+#define JTAG2UPDI_RETRY_MS    1000
+
 struct pdata
 {
   unsigned short command_sequence; /* Next cmd seqno to issue. */
@@ -90,6 +96,23 @@ struct pdata
   /* Most recent operation was a memory write or erase */
   int recently_written;
 
+  /* UPDI flash is blank after a chip erase, so all-0xff pages can be skipped */
+  int flash_erased;
+  unsigned int flash_end;       // End of flash written in ascending order since chip erase
+
+  /* Verify jtag2updi flash with the CRCSCAN peripheral */
+  int crc_verify;
+
+  /* Number of jtag2updi flash write frames kept in flight, 0 or 1: no pipelining */
+  int pipeline;
+  /* Ring of frames sent but not yet acknowledged, kept for resending */
+  int npending, phead;
+  struct {
+    unsigned int addr;
+    size_t len;
+    unsigned char frame[256 + 10];
+  } pending[JTAGMKII_MAX_PIPELINE];
+
 #define FLAGS32_INIT_SMC      1 // Part will undergo chip erase
 #define FLAGS32_WRITE         2 // At least one write operation specified
   // Couple of flag bits for AVR32 programming
@@ -399,7 +422,9 @@ static void jtagmkII_prmsg(const PROGRAMMER *pgm_unused, unsigned char *data, si
 }
 
 
-int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
+static int jtagmkII_send_seqno(const PROGRAMMER *pgm, unsigned char *data, size_t len,
+  unsigned short seqno) {
+
   unsigned char *buf;
 
   msg_debug("\n");
@@ -407,7 +432,7 @@ int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
 
   buf = mmt_malloc(len + 10);
   buf[0] = MESSAGE_START;
-  u16_to_b2(buf + 1, PDATA(pgm)->command_sequence);
+  u16_to_b2(buf + 1, seqno);
   u32_to_b4(buf + 3, len);
   buf[7] = TOKEN;
   memcpy(buf + 8, data, len);
@@ -425,6 +450,14 @@ int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
   return 0;
 }
 
+static int jtagmkII_updi_collect(const PROGRAMMER *pgm, int keep);
+
+int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
+  if (PDATA(pgm)->npending && jtagmkII_updi_collect(pgm, 0) < 0)
+    return -1;
+  return jtagmkII_send_seqno(pgm, data, len, PDATA(pgm)->command_sequence);
+}
+
 
 static int jtagmkII_drain(const PROGRAMMER *pgm, int display) {
   return serial_drain(&pgm->fd, display);
@@ -834,6 +867,10 @@ static int jtagmkII_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
 
   if (!(p->prog_modes & (PM_PDI | PM_UPDI)))
       pgm->initialize(pgm, p);
+  if (p->prog_modes & PM_UPDI) {
+    PDATA(pgm)->flash_erased = 1;
+    PDATA(pgm)->flash_end = 0;
+  }
 
   PDATA(pgm)->recently_written = 1;
   return 0;
@@ -1376,12 +1413,47 @@ static int jtagmkII_parseextparms(const PROGRAMMER *pgm, const LISTID extparms)
       }
     }
 
+    if (str_eq(pgm->type, "JTAGMKII_UPDI")) {
+      if (str_eq(extended_param, "pipeline")) {
+        PDATA(pgm)->pipeline = 4;
+        continue;
+      }
+      if (str_starts(extended_param, "pipeline=")) {
+        int n;
+        if (sscanf(extended_param, "pipeline=%i", &n) != 1 || n < 1 || n > JTAGMKII_MAX_PIPELINE) {
+          pmsg_error("pipeline depth must be between 1 and %d\n", JTAGMKII_MAX_PIPELINE);
+          return -1;
+        }
+        PDATA(pgm)->pipeline = n;
+        continue;
+      }
+      if (str_eq(extended_param, "crcverify")) {
+        PDATA(pgm)->crc_verify = 1;
+        continue;
+      }
+    }
+
+    if (str_eq(extended_param, "lowlatency")) {
+      if (pgm->conntype != CONNTYPE_SERIAL) {
+        pmsg_error("-xlowlatency only applies to serial connections\n");
+        return -1;
+      }
+      serial_low_latency = 1;
+      continue;
+    }
+
     if (str_eq(extended_param, "help")) {
       msg_error("%s -c %s extended options:\n", progname, pgmid);
       if (pgm->flag & PGM_FL_IS_JTAG)
         msg_error("  -xjtagchain=UB,UA,BB,BA Setup the JTAG scan chain order\n");
       if (pgm->flag & PGM_FL_IS_PDI)
         msg_error("  -xrtsdtr=low,high       Force RTS/DTR lines low or high state during programming\n");
+      if (str_eq(pgm->type, "JTAGMKII_UPDI")) {
+        msg_error("  -xpipeline[=<n>]        Keep up to n (4) flash page writes in flight\n");
+        msg_error("  -xcrcverify             Verify flash with the CRCSCAN peripheral, read back on mismatch\n");
+      }
+      if (pgm->conntype == CONNTYPE_SERIAL)
+        msg_error("  -xlowlatency            Set USB-serial adapter latency timer to 1 ms\n");
       msg_error(  "  -xhelp                  Show this help menu and exit\n");
       return LIBAVRDUDE_EXIT;;
     }
@@ -1870,15 +1942,160 @@ static int jtagmkII_page_erase(const PROGRAMMER *pgm, const AVRPART *p, const AV
   return 0;
 }
 
+/*
+ * Expected wait in ms for the response to a jtag2updi page write: the frame
+ * travels at the serial line rate while the reply only follows once the page
+ * has been programmed; allow twice the line time plus some headroom
+ */
+static long jtagmkII_updi_timeout(const PROGRAMMER *pgm, unsigned int page_size) {
+  long baud = pgm->baudrate? pgm->baudrate: 19200;
+
+  return 50 + 2*(page_size + 20)*10*1000L/baud;
+}
+
+// Fill in a write memory frame for the page at addr; returns 1 if it can be skipped
+static int jtagmkII_fill_page(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  unsigned char *cmd, unsigned int page_size, unsigned int addr, unsigned int maxaddr,
+  int dynamic_mtype) {
+
+  unsigned int block_size = maxaddr - addr < page_size? maxaddr - addr: page_size;
+
+  pmsg_debug("jtagmkII_paged_write(): "
+    "block_size at addr %d is %d\n", addr, block_size);
+
+  if (dynamic_mtype)
+    cmd[1] = jtagmkII_mtype(pgm, p, addr);
+
+  u32_to_b4(cmd + 2, page_size);
+  u32_to_b4(cmd + 6, jtagmkII_memaddr(pgm, p, m, addr));
+
+  /*
+   * The JTAG ICE will refuse to write anything but a full page, at
+   * least for the flash ROM.  If a partial page has been requested,
+   * set the remainder to 0xff.  (Maybe we should rather read back
+   * the existing contents instead before?  Doesn't matter much, as
+   * bits cannot be written to 1 anyway.)
+   */
+  memset(cmd + 10, 0xff, page_size);
+  memcpy(cmd + 10, m->buf + addr, block_size);
+
+  // UPDI page writes cannot set bits, so a blank page is a no-op after chip erase
+  if (PDATA(pgm)->flash_erased && mem_is_in_flash(m) && memall(cmd + 10, 0xff, page_size)) {
+    pmsg_debug("jtagmkII_paged_write(): skipping blank page at addr 0x%04x\n", addr);
+    return 1;
+  }
+  // Rewriting flash that was written since the chip erase means it is no longer pristine
+  if (PDATA(pgm)->flash_erased && mem_is_in_flash(m)) {
+    if (m->offset + addr < PDATA(pgm)->flash_end)
+      PDATA(pgm)->flash_erased = 0;
+    else
+      PDATA(pgm)->flash_end = m->offset + addr + page_size;
+  }
+
+  return 0;
+}
+
+/*
+ * jtag2updi write-behind for flash: page write frames are sent back to back,
+ * each with its own sequence number, and their responses are only collected
+ * once more than PDATA(pgm)->pipeline frames are in flight or before
+ * jtagmkII_paged_write() returns, so that pipelining pays off for calls
+ * that write several pages. Should a response not arrive in time, the pending
+ * frames are resent one at a time, which is harmless for pages that did get
+ * programmed as the data are the same.
+ */
+// Sequence number n commands after seqno; 0xffff is reserved for events
+static unsigned short jtagmkII_seqno_add(unsigned short seqno, int n) {
+  while (n-- > 0)
+    if (++seqno == 0xffff)
+      seqno = 0;
+
+  return seqno;
+}
+
+static int jtagmkII_updi_collect(const PROGRAMMER *pgm, int keep) {
+  struct pdata *pd = PDATA(pgm);
+  long otimeout = serial_recv_timeout;
+  unsigned char *resp;
+  int status, tries, rv = 0;
+
+  while (pd->npending > keep) {
+    size_t len = pd->pending[pd->phead].len;
+    serial_recv_timeout = jtagmkII_updi_timeout(pgm, len - 10);
+    status = jtagmkII_recv(pgm, &resp);
+    if (status <= 0) {          // Late rather than lost? Give it more time
+      serial_recv_timeout = JTAG2UPDI_RETRY_MS;
+      status = jtagmkII_recv(pgm, &resp);
+    }
+    if (status <= 0) {
+      msg_notice2("\n");
+      pmsg_notice("no response to pipelined page write (status %d), resending pending pages\n", status);
+      jtagmkII_drain(pgm, 0);
+      for (tries = 0; status <= 0 && tries < JTAG2UPDI_TRIES; tries++) {
+        serial_recv_timeout = JTAG2UPDI_RETRY_MS;
+        jtagmkII_send_seqno(pgm, pd->pending[pd->phead].frame, len, pd->command_sequence);
+        status = jtagmkII_recv(pgm, &resp);
+      }
+      if (status <= 0) {
+        pmsg_error("no response to write memory command at addr 0x%04x (status %d)\n",
+          pd->pending[pd->phead].addr, status);
+        rv = -1;
+        break;
+      }
+      // Resend the others in order so responses pair with command_sequence again
+      for (int i = 1; i < pd->npending; i++) {
+        int k = (pd->phead + i) % pd->pipeline;
+        jtagmkII_send_seqno(pgm, pd->pending[k].frame, pd->pending[k].len,
+          jtagmkII_seqno_add(pd->command_sequence, i - 1));
+      }
+    }
+    msg_notice2("0x%02x (%d bytes msg)\n", resp[0], status);
+    if (resp[0] != RSP_OK) {
+      pmsg_error("bad response to write memory command at addr 0x%04x: %s\n",
+        pd->pending[pd->phead].addr, jtagmkII_get_rc(pgm, resp[0]));
+      mmt_free(resp);
+      rv = -1;
+      break;
+    }
+    mmt_free(resp);
+    pd->phead = (pd->phead + 1) % pd->pipeline;
+    pd->npending--;
+  }
+
+  if (rv < 0) {
+    jtagmkII_drain(pgm, 0);
+    pd->npending = 0;
+  }
+  serial_recv_timeout = otimeout;
+  return rv;
+}
+
+static int jtagmkII_updi_queue(const PROGRAMMER *pgm, unsigned char *cmd, size_t len, unsigned int addr) {
+  struct pdata *pd = PDATA(pgm);
+  int k = (pd->phead + pd->npending) % pd->pipeline;
+  unsigned short seqno = jtagmkII_seqno_add(pd->command_sequence, pd->npending);
+
+  memcpy(pd->pending[k].frame, cmd, len);
+  pd->pending[k].len = len;
+  pd->pending[k].addr = addr;
+  pmsg_notice2("jtagmkII_paged_write(): queueing write memory command %u\n", seqno);
+  if (jtagmkII_send_seqno(pgm, cmd, len, seqno) < 0)
+    return -1;
+  pd->npending++;
+
+  return jtagmkII_updi_collect(pgm, pd->pipeline - 1);
+}
+
 static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
                                 unsigned int page_size,
                                 unsigned int addr, unsigned int n_bytes)
 {
-  unsigned int block_size;
   unsigned int maxaddr = addr + n_bytes;
   unsigned char *cmd;
   unsigned char *resp;
   int status, tries, dynamic_mtype = 0;
+  // jtag2updi flash writes use a timeout profile derived from the line rate
+  int tuned = str_eq(pgm->type, "JTAGMKII_UPDI") && mem_is_in_flash(m);
   long otimeout = serial_recv_timeout;
 
   pmsg_notice2("jtagmkII_paged_write(.., %s, %d, %d)\n", m->desc, page_size, n_bytes);
@@ -1923,32 +2140,24 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
   } else {
     cmd[1] = MTYPE_SPM;
   }
-  serial_recv_timeout = 200;
-  for (; addr < maxaddr; addr += page_size) {
-    if ((maxaddr - addr) < page_size)
-      block_size = maxaddr - addr;
-    else
-      block_size = page_size;
-    pmsg_debug("jtagmkII_paged_write(): "
-      "block_size at addr %d is %d\n", addr, block_size);
-
-    if (dynamic_mtype)
-      cmd[1] = jtagmkII_mtype(pgm, p, addr);
+  serial_recv_timeout = tuned? jtagmkII_updi_timeout(pgm, page_size): 200;
 
-    u32_to_b4(cmd + 2, page_size);
-    u32_to_b4(cmd + 6, jtagmkII_memaddr(pgm, p, m, addr));
+  for (; addr < maxaddr; addr += page_size) {
+    if (jtagmkII_fill_page(pgm, p, m, cmd, page_size, addr, maxaddr, dynamic_mtype))
+      continue;
 
-    /*
-     * The JTAG ICE will refuse to write anything but a full page, at
-     * least for the flash ROM.  If a partial page has been requested,
-     * set the remainder to 0xff.  (Maybe we should rather read back
-     * the existing contents instead before?  Doesn't matter much, as
-     * bits cannot be written to 1 anyway.)
-     */
-    memset(cmd + 10, 0xff, page_size);
-    memcpy(cmd + 10, m->buf + addr, block_size);
+    if (tuned && PDATA(pgm)->pipeline > 1) {
+      if (jtagmkII_updi_queue(pgm, cmd, page_size + 10, addr) < 0) {
+        mmt_free(cmd);
+        serial_recv_timeout = otimeout;
+        return -1;
+      }
+      continue;
+    }
 
     tries = 0;
+    if (tuned)
+      serial_recv_timeout = jtagmkII_updi_timeout(pgm, page_size);
 
     retry:
       pmsg_notice2("jtagmkII_paged_write(): "
@@ -1956,11 +2165,15 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
     jtagmkII_send(pgm, cmd, page_size + 10);
 
     status = jtagmkII_recv(pgm, &resp);
+    if (status <= 0 && tuned) { // Late rather than lost? Give it more time
+      serial_recv_timeout = JTAG2UPDI_RETRY_MS;
+      status = jtagmkII_recv(pgm, &resp);
+    }
     if (status <= 0) {
       msg_notice2("\n");
       pmsg_warning("timeout/error communicating with programmer (status %d)\n", status);
-      if (tries++ < 4) {
-	serial_recv_timeout *= 2;
+      if (tries++ < (tuned? JTAG2UPDI_TRIES-1: 4)) {
+	serial_recv_timeout = tuned? JTAG2UPDI_RETRY_MS: serial_recv_timeout*2;
 	goto retry;
       }
       pmsg_error("timeout/error communicating with programmer (status %d)\n", status);
@@ -1986,6 +2199,10 @@ static int jtagmkII_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
   mmt_free(cmd);
   serial_recv_timeout = otimeout;
 
+  // Collect the pages still in flight, so failures show here rather than with a later command
+  if (tuned && PDATA(pgm)->npending && jtagmkII_updi_collect(pgm, 0) < 0)
+    return -1;
+
   PDATA(pgm)->recently_written = 1;
   return n_bytes;
 }
@@ -3606,6 +3823,11 @@ static int jtagmkII_updi_end_programming(const PROGRAMMER *pgm, const AVRPART *p
   return PDATA(pgm)->recently_written? avr_read(pgm, p, "signature", NULL): 0;
 }
 
+// Let CRCSCAN check flash written once after a chip erase if requested by -xcrcverify
+static int jtagmkII_updi_crc_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m) {
+  return PDATA(pgm)->crc_verify && PDATA(pgm)->flash_erased? avr_crcscan_verify(pgm, p, m): 0;
+}
+
 #ifdef __OBJC__
 #pragma mark -
 #endif
@@ -3714,6 +3936,7 @@ const char jtagmkII_updi_desc[] = "Atmel JTAG ICE mkII in UPDI mode";
 
 void jtagmkII_updi_initpgm(PROGRAMMER *pgm) {
   strcpy(pgm->type, "JTAGMKII_UPDI");
+  pgm->paged_max = 65535;       // Paged r/w loop over pages, so can do several
 
   /*
    * mandatory functions
@@ -3744,6 +3967,7 @@ void jtagmkII_updi_initpgm(PROGRAMMER *pgm) {
   pgm->flag           = PGM_FL_IS_PDI;
   pgm->term_keep_alive= jtagmkII_updi_term_keep_alive;
   pgm->end_programming= jtagmkII_updi_end_programming;
+  pgm->crc_verify     = jtagmkII_updi_crc_verify;
 }
 
 const char jtagmkII_dragon_desc[] = "Atmel AVR Dragon in JTAG mode";
@@ -563,6 +563,9 @@ AVRMEM * avr_locate_mem_by_type(const AVRPART *p, memtype_t type);
 unsigned int avr_data_offset(const AVRPART *p);
 AVRMEM_ALIAS * avr_locate_memalias(const AVRPART *p, const char *desc);
 AVRMEM_ALIAS * avr_find_memalias(const AVRPART *p, const AVRMEM *m_orig);
+int avr_mem_next_allocated(const AVRMEM *mem, int addr, int end);
+int avr_mem_next_hole(const AVRMEM *mem, int addr, int end);
+int avr_mem_next_page(const AVRMEM *mem, int pageaddr, int end, int pgsize);
 void avr_mem_display(FILE *f, const AVRPART *p, const char *prefix);
 
 /* Functions for AVRPART structures */
@@ -783,6 +786,7 @@ const char * pinmask_to_str(const pinmask_t * const pinmask);
 
 extern long serial_recv_timeout;  /* ms */
 extern long serial_drain_timeout; /* ms */
+extern int serial_low_latency;    /* Minimise USB-serial adapter latency timer on open */
 
 union filedescriptor
 {
@@ -863,6 +867,8 @@ extern struct serial_device usb_serdev;
 extern struct serial_device usb_serdev_frame;
 extern struct serial_device avrdoper_serdev;
 extern struct serial_device usbhid_serdev;
+extern struct serial_device record_serdev;
+extern struct serial_device replay_serdev;
 
 #define serial_open (serdev->open)
 #define serial_setparams (serdev->setparams)
@@ -879,6 +885,7 @@ typedef struct {                // Memory cache for a subset of cached pages
   unsigned int offset;          // Offset of flash/eeprom memory
   unsigned char *cont, *copy;   // current memory contens and device copy of it
   unsigned char *iscached;      // iscached[i] set when page i has been loaded
+  int nextpg, nahead;           // Read ahead nahead pages if page nextpg is loaded next
 } AVR_Cache;
 
 /* formerly pgm.h */
@@ -973,6 +980,7 @@ typedef struct programmer_t {
   int ppictrl;
   int ispdelay;                 // ISP clock delay
   int page_size;                // Page size if the programmer supports paged write/load
+  int paged_max;                // Max n_bytes paged_load()/paged_write() take in one call, 0: a page
   double bitclock;              // JTAG ICE clock period in microseconds
   leds_t *leds;                 // State of LEDs as tracked by led_...()  functions in leds.c
 
@@ -1034,6 +1042,8 @@ typedef struct programmer_t {
   void (*setup)          (struct programmer_t *pgm);
   void (*teardown)       (struct programmer_t *pgm);
   int  (*flash_readhook) (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *flm, const char *fname, int size);
+  int  (*crc_verify)     (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m);
+  int  (*device_id)      (const struct programmer_t *pgm, const AVRPART *p, char *id, size_t n);
   // Cached r/w API for terminal reads/writes
   int (*write_byte_cached)(const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m,
                           unsigned long addr, unsigned char value);
@@ -1046,7 +1056,7 @@ typedef struct programmer_t {
                           unsigned int addr);
   int (*flush_cache)     (const struct programmer_t *pgm, const AVRPART *p);
   int (*reset_cache)     (const struct programmer_t *pgm, const AVRPART *p);
-  AVR_Cache *cp_flash, *cp_eeprom, *cp_bootrow, *cp_usersig;
+  AVR_Cache *cp_flash, *cp_eeprom, *cp_bootrow, *cp_usersig, *cp_bytes;
 
   const char *config_file;      // Config file where defined
   int  lineno;                  // Config file line number
@@ -1145,12 +1155,17 @@ int avr_write_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, in
 
 int avr_write(const PROGRAMMER *pgm, const AVRPART *p, const char *memstr, int size, int auto_erase);
 
+int avr_write_verify_mem(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+  int size, int auto_erase, int vsize);
+
 int avr_signature(const PROGRAMMER *pgm, const AVRPART *p);
 
 int avr_mem_bitmask(const AVRPART *p, const AVRMEM *mem, int addr);
 
 int avr_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRPART *v, const char *m, int size);
 
+int avr_crcscan_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m);
+
 int avr_get_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int *cycles);
 
 int avr_put_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int cycles);
@@ -1192,11 +1207,22 @@ int avr_is_and(const unsigned char *s1, const unsigned char *s2, const unsigned
 
 // Bytewise cached read/write API
 int avr_read_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, unsigned long addr, unsigned char *value);
+int avr_prefetch_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int addr, int len);
 int avr_write_byte_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, unsigned long addr, unsigned char data);
 int avr_chip_erase_cached(const PROGRAMMER *pgm, const AVRPART *p);
 int avr_page_erase_cached(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, unsigned int baseaddr);
 int avr_flush_cache(const PROGRAMMER *pgm, const AVRPART *p);
 int avr_reset_cache(const PROGRAMMER *pgm, const AVRPART *p);
+void avr_forget_byte_cache(const PROGRAMMER *pgm);
+int avr_write_mem_diff(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, int size,
+  const AVRMEM *img, int *npagesp);
+
+// Host-side device image cache
+AVRMEM *avr_devimage_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem);
+int avr_devimage_save(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRMEM *old);
+void avr_devimage_forget(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem);
+int avr_devimage_agrees(const AVRMEM *img, const AVRMEM *mem, int beg, int end);
+int avr_devimage_sample(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem, const AVRMEM *img, int size);
 
 #ifdef __cplusplus
 }
@@ -1273,7 +1299,8 @@ int fileio_segments(int oprwv, const char *filename, FILEFMT format,
 enum {
   DEVICE_READ,
   DEVICE_WRITE,
-  DEVICE_VERIFY
+  DEVICE_VERIFY,
+  DEVICE_DIFFWRITE,             // Only write pages that differ from device contents
 };
 
 enum updateflags {
@@ -1281,6 +1308,8 @@ enum updateflags {
   UF_NOWRITE = 1,
   UF_AUTO_ERASE = 2,
   UF_VERIFY = 4,
+  UF_DEVIMAGE = 8,              // Use and update the host-side device image cache
+  UF_PAGEVERIFY = 16,           // Verify each page right after writing it
 };
 
 
@@ -1290,6 +1319,9 @@ typedef struct update_t {
   int   op;                     // Symbolic memory operation DEVICE_... for -U
   char *filename;               // Filename for -U, can be -
   int   format;                 // File format FMT_...
+  char *basefile;               // Reference image of device memory for -U :d: or NULL
+  int   basefmt;                // File format FMT_... of reference image
+  int   padbase;                // -U :w: turned into :d: by -R: input is 0xff wherever it has no data
 } UPDATE;
 
 typedef struct {                // File reads for flash can exclude trailing 0xff, which are cut off
@@ -1498,6 +1530,8 @@ const char *str_interval(int a, int b);
 bool is_bigendian(void);
 void change_endian(void *p, int size);
 int memall(const void *p, char c, size_t n);
+long memrnot(const void *p, char c, size_t n);
+int memisand(const void *s1, const void *s2, const void *s3, size_t n);
 unsigned long long int str_ull(const char *str, char **endptr, int base);
 Str2data *str_todata(const char *str, int type, const AVRPART *part, const char *memstr);
 void str_freedata(Str2data *sd);
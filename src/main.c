@@ -360,11 +360,16 @@ static void usage(void)
     "  -O                     Perform RC oscillator calibration (see AVR053)\n"
     "  -t                     Run an interactive terminal when it is its turn\n"
     "  -T <terminal cmd line> Run terminal line when it is its turn\n"
-    "  -U <memstr>:r|w|v:<filename>[:format]\n"
+    "  -U <memstr>:r|w|v|d:<filename>[:format]\n"
     "                         Carry out memory operation when it is its turn\n"
     "                         Multiple -t, -T and -U options can be specified\n"
+    "  -R <filename>[:format] Reference image of flash: -U flash:w only writes\n"
+    "                         pages that differ from it; no device reads\n"
     "  -n                     Do not write to the device whilst processing -U\n"
     "  -V                     Do not automatically verify during -U\n"
+    "  -W                     Verify -U writes page by page right after writing\n"
+    "  -k                     Keep images of verified flash writes per device in\n"
+    "                         the user cache dir; use them to spare device reads\n"
     "  -E <exitsp>[,<exitsp>] List programmer exit specifications\n"
     "  -x <extended_param>    Pass <extended_param> to programmer, see -xhelp\n"
     "  -v                     Verbose output; -v -v for more\n"
@@ -732,6 +737,7 @@ int main(int argc, char * argv [])
   AVRMEM         * sig;         /* signature data */
   struct stat      sb;
   UPDATE         * upd;
+  UPDATE         * base;        /* -R reference image for flash writes */
   LNODEID        * ln;
 
   /* options / operating mode variables */
@@ -847,6 +853,7 @@ int main(int argc, char * argv [])
   is_open       = 0;
   ce_delayed    = 0;
   logfile       = NULL;
+  base          = NULL;
 
   len = strlen(progname) + 2;
   for (i=0; i<len; i++)
@@ -876,7 +883,7 @@ int main(int argc, char * argv [])
   /*
    * process command line arguments
    */
-  while ((ch = getopt(argc,argv,"?Ab:B:c:C:DeE:Fi:l:nNp:OP:qrstT:U:uvVx:yY:")) != -1) {
+  while ((ch = getopt(argc,argv,"?Ab:B:c:C:DeE:Fi:kl:nNp:OP:qrR:stT:U:uvVWx:yY:")) != -1) {
 
     switch (ch) {
       case 'b': /* override default programmer baud rate */
@@ -957,6 +964,10 @@ int main(int argc, char * argv [])
         ovsigck = 1;
         break;
 
+      case 'k': /* keep and use host-side images of written device memories */
+        uflags |= UF_DEVIMAGE;
+        break;
+
       case 'l':
         logfile = optarg;
         break;
@@ -989,6 +1000,17 @@ int main(int argc, char * argv [])
         touch_1200bps++;
         break;
 
+      case 'R': /* reference image of flash for delta writes */
+        free_update(base);
+        char *op = str_sprintf("flash:d:%s", optarg);
+        base = parse_op(op);
+        free(op);
+        if (base == NULL) {
+          pmsg_error("unable to parse reference image '%s'\n", optarg);
+          exit(1);
+        }
+        break;
+
       case 't': /* enter terminal mode */
         ladd(updates, cmd_update("interactive terminal"));
         break;
@@ -1019,6 +1041,10 @@ int main(int argc, char * argv [])
         uflags &= ~UF_VERIFY;
         break;
 
+      case 'W': /* verify each page right after writing it */
+        uflags |= UF_PAGEVERIFY;
+        break;
+
       case 'x':
         ladd(extended_params, optarg);
         break;
@@ -1579,20 +1605,33 @@ skipopen:
    * and check for basic problems with memory names or file access with a
    * view to exit before programming.
    */
-  int doexit = 0;
+  int doexit = 0, nbase = 0;
   for (ln=lfirst(updates); ln; ln=lnext(ln)) {
     upd = ldata(ln);
     if (upd->memstr == NULL && upd->cmdline == NULL) {
       const char *mtype = p->prog_modes & PM_PDI? "application": "flash";
       pmsg_notice2("defaulting memstr in -U %c:%s option to \"%s\"\n",
-        (upd->op == DEVICE_READ)? 'r': (upd->op == DEVICE_WRITE)? 'w': 'v',
+        (upd->op == DEVICE_READ)? 'r': (upd->op == DEVICE_WRITE)? 'w': (upd->op == DEVICE_DIFFWRITE)? 'd': 'v',
         upd->filename, mtype);
       upd->memstr = cfg_strdup("main()", mtype);
     }
+    // With a reference image, flash writes only write pages that differ from it
+    const AVRMEM *m;
+    if (base && upd->memstr && (upd->op == DEVICE_WRITE || upd->op == DEVICE_DIFFWRITE) &&
+      (m = avr_locate_mem(p, upd->memstr)) && mem_is_in_flash(m)) {
+      upd->padbase = upd->op == DEVICE_WRITE;
+      upd->op = DEVICE_DIFFWRITE;
+      free(upd->basefile);
+      upd->basefile = cfg_strdup("main()", base->filename);
+      upd->basefmt = base->format;
+      nbase++;
+    }
     rc = update_dryrun(p, upd);
     if (rc && rc != LIBAVRDUDE_SOFTFAIL)
       doexit = 1;
   }
+  if (base && !nbase)
+    pmsg_warning("ignoring -R %s as there is no -U flash write\n", base->filename);
   if(doexit) {
     exitrc = 1;
     goto main_exit;
@@ -1825,6 +1864,9 @@ skipopen:
       pmsg_warning("%s-n specified, NOT erasing chip\n", explicit_e? "conflicting -e and ": "");
     } else {
       pmsg_info("erasing chip\n");
+      const AVRMEM *flm;
+      if((uflags & UF_DEVIMAGE) && (flm = avr_locate_flash(p))) // Image no longer reflects the device
+        avr_devimage_forget(pgm, p, flm);
       exitrc = avr_chip_erase(pgm, p);
       if(exitrc == LIBAVRDUDE_SOFTFAIL) {
         imsg_info("delaying chip erase until first -U upload to flash\n");
@@ -1850,7 +1892,7 @@ skipopen:
       pgm->reset_cache(pgm, p);
     } else if(!upd->cmdline) {  // Flush cache before any device memory access
       pgm->flush_cache(pgm, p);
-      wrmem |= upd->op == DEVICE_WRITE;
+      wrmem |= upd->op == DEVICE_WRITE || upd->op == DEVICE_DIFFWRITE;
     }
     if((uflags & UF_NOWRITE) && upd->cmdline && !terminal++)
       pmsg_warning("the terminal ignores option -n, that is, it writes to the device\n");
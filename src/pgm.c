@@ -133,6 +133,8 @@ void pgm_init_functions(PROGRAMMER *pgm) {
   pgm->teardown       = NULL;
   pgm->readonly       = NULL;
   pgm->flash_readhook = NULL;
+  pgm->crc_verify     = NULL;
+  pgm->device_id      = NULL;
 }
 
 
@@ -157,6 +159,7 @@ PROGRAMMER *pgm_new(void) {
   pgm->cp_eeprom = cfg_malloc("pgm_new()", sizeof(AVR_Cache));
   pgm->cp_bootrow = cfg_malloc("pgm_new()", sizeof(AVR_Cache));
   pgm->cp_usersig = cfg_malloc("pgm_new()", sizeof(AVR_Cache));
+  pgm->cp_bytes = cfg_malloc("pgm_new()", sizeof(AVR_Cache));
 
   // Default values
   pgm->initpgm = NULL;
@@ -196,7 +199,7 @@ void pgm_free(PROGRAMMER *p) {
     free(p->leds); p->leds = NULL;
     // Never free const char *, eg, p->desc, which are set by cache_string()
     // p->cookie was freed by pgm_teardown
-    // Never free cp_flash, cp_eeprom, cp_bootrow or cp_usersig cache structures
+    // Never free cp_flash, cp_eeprom, cp_bootrow, cp_usersig or cp_bytes cache structures
     free(p);
   }
 }
@@ -217,6 +220,8 @@ PROGRAMMER *pgm_dup(const PROGRAMMER *src) {
       free(pgm->cp_bootrow);
     if(pgm->cp_usersig)
       free(pgm->cp_usersig);
+    if(pgm->cp_bytes)
+      free(pgm->cp_bytes);
 
     leds_t *ls = pgm->leds;
     memcpy(pgm, src, sizeof(*pgm));
@@ -36,24 +36,31 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/time.h>
-#include <sys/select.h>
 #include <sys/socket.h>
 #include <netdb.h>
 
 #include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef __APPLE__
 # include <IOKit/serial/ioss.h>
 #endif
 
+#if defined(__linux__)
+# include <linux/serial.h>
+#endif
+
 #include "avrdude.h"
 #include "libavrdude.h"
 #include "libserial/LibSerial.h"
 
 long serial_recv_timeout = 5000; /* ms */
 long serial_drain_timeout = 250; /* ms */
+int serial_low_latency = 0;
 
 struct baud_mapping {
   long baud;
@@ -125,6 +132,16 @@ static struct baud_mapping baud_lookup_table [] = {
 static struct termios original_termios;
 static int saved_original_termios;
 
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+static int original_serial_flags;
+static int saved_original_serial_flags;
+#endif
+
+#if defined(__linux__)
+static char *latency_timer_path; // sysfs attribute changed by ser_set_latency_timer()
+static int original_latency_timer;
+#endif
+
 static speed_t serial_baud_lookup(long baud, bool *nonstandard) {
   struct baud_mapping *map = baud_lookup_table;
 
@@ -253,6 +270,12 @@ static int ser_setparams(const union filedescriptor *fd, long baud, unsigned lon
   termios.c_iflag &= ~CNEW_RTSCTS;
 #endif /* CRTSCTS */
 
+  /*
+   * Reads are non-blocking and paced by poll() in ser_recv(), so do not
+   * let the tty layer add an inter-character timer of its own
+   */
+  termios.c_cc[VMIN] = 1;
+  termios.c_cc[VTIME] = 0;
 
   rc = tcsetattr(fd->ifd, TCSANOW, &termios);
   if (rc < 0) {
@@ -277,6 +300,170 @@ static int ser_setparams(const union filedescriptor *fd, long baud, unsigned lon
   return 0;
 }
 
+/*
+ * With -xlowlatency ask the tty driver to push received characters up
+ * immediately rather than batching them; silently ignored where the driver
+ * does not support it. The original setting is restored by ser_close().
+ */
+static void ser_set_low_latency(const union filedescriptor *fd) {
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+  struct serial_struct ss;
+
+  if (!serial_low_latency || ioctl(fd->ifd, TIOCGSERIAL, &ss) < 0)
+    return;
+
+  if (!saved_original_serial_flags) {
+    original_serial_flags = ss.flags;
+    saved_original_serial_flags = 1;
+  }
+
+  if (!(ss.flags & ASYNC_LOW_LATENCY)) {
+    ss.flags |= ASYNC_LOW_LATENCY;
+    if (ioctl(fd->ifd, TIOCSSERIAL, &ss) < 0)
+      pmsg_notice2("ser_set_low_latency(): cannot set ASYNC_LOW_LATENCY: %s\n", strerror(errno));
+  }
+#endif
+}
+
+static void ser_restore_low_latency(const union filedescriptor *fd) {
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+  struct serial_struct ss;
+
+  if (!saved_original_serial_flags)
+    return;
+  saved_original_serial_flags = 0;
+
+  if (ioctl(fd->ifd, TIOCGSERIAL, &ss) < 0 || ss.flags == original_serial_flags)
+    return;
+  ss.flags = original_serial_flags;
+  if (ioctl(fd->ifd, TIOCSSERIAL, &ss) < 0)
+    pmsg_notice2("ser_restore_low_latency(): cannot restore serial flags: %s\n", strerror(errno));
+#endif
+}
+
+#if defined(__linux__)
+// Write an integer to a sysfs attribute; returns 0 on success and -1 with errno set otherwise
+static int ser_write_sysfs_int(const char *path, int val) {
+  FILE *fp = fopen(path, "w");
+  int rc;
+
+  if (!fp)
+    return -1;
+  rc = fprintf(fp, "%d\n", val) < 0? -1: 0;
+  if (fclose(fp) != 0)
+    rc = -1;
+
+  return rc;
+}
+#endif
+
+/*
+ * USB-serial adapters such as the FTDI FT232R only forward a partially
+ * filled receive buffer to the host when their latency timer expires,
+ * which is 16 ms by default. As every short bootloader or UPDI response
+ * waits for that, set the timer to 1 ms when -xlowlatency was requested.
+ * The original value is restored by ser_close(). Adapters without this
+ * sysfs attribute, eg, CH340, rely on ASYNC_LOW_LATENCY instead.
+ */
+static void ser_set_latency_timer(const char *port) {
+#if defined(__linux__)
+  char *rpath, *tty, path[256];
+  FILE *fp;
+  int rc, val;
+
+  if (!serial_low_latency || latency_timer_path)
+    return;
+
+  if (!(rpath = realpath(port, NULL)))
+    return;
+  tty = strrchr(rpath, '/');
+  snprintf(path, sizeof path, "/sys/bus/usb-serial/devices/%s/latency_timer", tty? tty+1: rpath);
+  free(rpath);
+
+  if (!(fp = fopen(path, "r"))) {
+    pmsg_notice2("ser_set_latency_timer(): %s has no latency timer\n", port);
+    return;
+  }
+  rc = fscanf(fp, "%d", &val);
+  fclose(fp);
+  if (rc != 1 || val <= 1)
+    return;
+
+  if (ser_write_sysfs_int(path, 1) < 0) {
+    pmsg_warning("cannot set latency timer of %s to 1 ms: %s\n", port, strerror(errno));
+    imsg_warning("check write permission for %s\n", path);
+    return;
+  }
+
+  pmsg_notice2("ser_set_latency_timer(): latency timer of %s changed from %d ms to 1 ms\n", port, val);
+  latency_timer_path = mmt_strdup(path);
+  original_latency_timer = val;
+#endif
+}
+
+static void ser_restore_latency_timer(void) {
+#if defined(__linux__)
+  if (!latency_timer_path)
+    return;
+
+  if (ser_write_sysfs_int(latency_timer_path, original_latency_timer) < 0)
+    pmsg_warning("cannot restore latency timer in %s: %s\n", latency_timer_path, strerror(errno));
+
+  mmt_free(latency_timer_path);
+  latency_timer_path = NULL;
+#endif
+}
+
+// Monotonic time in ms for absolute deadlines that are immune to wall clock changes
+static uint64_t ser_mstime(void) {
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec*1000ULL + ts.tv_nsec/1000000;
+#endif
+
+  return avr_mstimestamp();
+}
+
+/*
+ * Wait until fd is ready for events (POLLIN or POLLOUT) or the absolute
+ * deadline (see ser_mstime()) has passed. Interrupted waits are resumed
+ * with the remaining time only. Returns 1 if ready, 0 on timeout and -1
+ * on error.
+ */
+static int ser_poll(int fd, short events, uint64_t deadline) {
+  struct pollfd pfd;
+  uint64_t now;
+  int rc, ms;
+
+  while (1) {
+    now = ser_mstime();
+    ms = now >= deadline? 0: deadline - now > INT_MAX? INT_MAX: (int) (deadline - now);
+
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    rc = poll(&pfd, 1, ms);
+    if (rc > 0) {
+      if (pfd.revents & events)
+        return 1;
+      if (pfd.revents & POLLHUP)
+        pmsg_ext_error("device has hung up\n");
+      else
+        pmsg_ext_error("poll(): unexpected event 0x%x\n", pfd.revents);
+      return -1;
+    }
+    if (rc == 0)
+      return 0;
+    if (errno != EINTR && errno != EAGAIN) {
+      pmsg_ext_error("poll(): %s\n", strerror(errno));
+      return -1;
+    }
+  }
+}
+
 /*
  * Given a port description of the form <host>:<port>, open a TCP
  * connection to the specified destination, which is assumed to be a
@@ -359,6 +546,11 @@ static int ser_set_dtr_rts(const union filedescriptor *fdp, int is_on) {
 
   r = ioctl(fdp->ifd, TIOCMGET, &ctl);
   if (r < 0) {
+    // Pseudo terminals and some virtual ports have no modem control lines
+    if (errno == ENOTTY || errno == EINVAL) {
+      pmsg_notice2("ser_set_dtr_rts(): port has no modem control lines, ignoring DTR/RTS\n");
+      return 0;
+    }
     pmsg_ext_error("ioctl(\"TIOCMGET\"): %s\n", strerror(errno));
     return -1;
   }
@@ -393,6 +585,14 @@ static int ser_open(const char *port, union pinfo pinfo, union filedescriptor *f
     return net_open(port + strlen("net:"), fdp);
   }
 
+  /*
+   * Hand record:<file>:<port> and replay:<file> over to ser_record.c
+   */
+  if (str_starts(port, "record:") || str_starts(port, "replay:")) {
+    serdev = str_starts(port, "record:")? &record_serdev: &replay_serdev;
+    return serdev->open(port, pinfo, fdp);
+  }
+
   /*
    * open the serial port
    */
@@ -417,6 +617,9 @@ static int ser_open(const char *port, union pinfo pinfo, union filedescriptor *f
     close(fd);
     return -1;
   }
+  ser_set_low_latency(fdp);
+  ser_set_latency_timer(port);
+
   return 0;
 }
 
@@ -436,11 +639,13 @@ static void ser_close(union filedescriptor *fd) {
     }
     saved_original_termios = 0;
   }
+  ser_restore_low_latency(fd);
+  ser_restore_latency_timer();
 
   close(fd->ifd);
 }
 
-// Close but don't restore attributes
+// Close but don't restore attributes; latency settings are restored by the final ser_close()
 static void ser_rawclose(union filedescriptor *fd) {
   saved_original_termios = 0;
   close(fd->ifd);
@@ -452,6 +657,7 @@ static int ser_send(const union filedescriptor *fd, const unsigned char *buf, si
     return 0;
 #endif
   int rc;
+  uint64_t deadline = ser_mstime() + serial_recv_timeout;
 
   if(verbose > 3)
     trace_buffer(__func__, buf, len);
@@ -459,11 +665,20 @@ static int ser_send(const union filedescriptor *fd, const unsigned char *buf, si
   while(len) {
     rc = write(fd->ifd, buf, len > 1024? 1024: len);
     if (rc < 0) {
+      if (errno == EAGAIN || errno == EINTR) { // Output queue full: wait for room
+        rc = ser_poll(fd->ifd, POLLOUT, deadline);
+        if (rc > 0)
+          continue;
+        if (rc == 0)
+          pmsg_ext_error("unable to write: timeout\n");
+        return -1;
+      }
       pmsg_ext_error("unable to write: %s\n", strerror(errno));
       return -1;
     }
     buf += rc;
     len -= rc;
+    deadline = ser_mstime() + serial_recv_timeout; // Still making progress
   }
 
   return 0;
@@ -479,43 +694,31 @@ static int ser_recv(const union filedescriptor *fd, unsigned char *buf, size_t b
     }
     return 0;
 #endif
-  struct timeval timeout, to2;
-  fd_set rfds;
-  int nfds;
   int rc;
   unsigned char *p = buf;
   size_t len = 0;
-
-  timeout.tv_sec  = serial_recv_timeout / 1000L;
-  timeout.tv_usec = (serial_recv_timeout % 1000L) * 1000;
-  to2 = timeout;
+  uint64_t deadline = ser_mstime() + serial_recv_timeout;
 
   while (len < buflen) {
-  reselect:
-    FD_ZERO(&rfds);
-    FD_SET(fd->ifd, &rfds);
-
-    nfds = select(fd->ifd + 1, &rfds, NULL, NULL, &to2);
-    if (nfds == 0) {
+    rc = ser_poll(fd->ifd, POLLIN, deadline);
+    if (rc == 0) {
       pmsg_notice2("ser_recv(): programmer is not responding\n");
       return -1;
     }
-    else if (nfds == -1) {
-      if (errno == EINTR || errno == EAGAIN) {
-	pmsg_warning("programmer is not responding, reselecting\n");
-        goto reselect;
-      }
-      else {
-        pmsg_ext_error("select(): %s\n", strerror(errno));
-        return -1;
-      }
-    }
+    if (rc < 0)
+      return -1;
 
     rc = read(fd->ifd, p, buflen - len > 1024? 1024: buflen - len);
     if (rc < 0) {
+      if (errno == EAGAIN || errno == EINTR)
+        continue;
       pmsg_ext_error("unable to read: %s\n", strerror(errno));
       return -1;
     }
+    if (rc == 0) {
+      pmsg_ext_error("unable to read: end of file\n");
+      return -1;
+    }
     p += rc;
     len += rc;
   }
@@ -532,49 +735,38 @@ static int ser_drain(const union filedescriptor *fd, int display) {
     serialPortDrain(serial_drain_timeout);
     return 0;
 #endif
-  struct timeval timeout;
-  fd_set rfds;
-  int nfds;
   int rc;
-  unsigned char buf;
-
-  timeout.tv_sec = 0;
-  timeout.tv_usec = serial_drain_timeout*1000L;
+  unsigned char buf[128];
+  uint64_t deadline = ser_mstime() + serial_drain_timeout;
 
   if (display) {
     msg_info("drain>");
   }
 
   while (1) {
-    FD_ZERO(&rfds);
-    FD_SET(fd->ifd, &rfds);
-
-  reselect:
-    nfds = select(fd->ifd + 1, &rfds, NULL, NULL, &timeout);
-    if (nfds == 0) {
+    rc = ser_poll(fd->ifd, POLLIN, deadline);
+    if (rc == 0) {
       if (display) {
         msg_info("<drain\n");
       }
-      
+
       break;
     }
-    else if (nfds == -1) {
-      if (errno == EINTR) {
-        goto reselect;
-      }
-      else {
-        pmsg_ext_error("select(): %s\n", strerror(errno));
-        return -1;
-      }
-    }
+    if (rc < 0)
+      return -1;
 
-    rc = read(fd->ifd, &buf, 1);
+    rc = read(fd->ifd, buf, sizeof buf);
     if (rc < 0) {
+      if (errno == EAGAIN || errno == EINTR)
+        continue;
       pmsg_ext_error("unable to read: %s\n", strerror(errno));
       return -1;
     }
+    if (rc == 0)                // End of file: nothing left to drain
+      break;
     if (display) {
-      msg_info("%02x ", buf);
+      for (int i = 0; i < rc; i++)
+        msg_info("%02x ", buf[i]);
     }
   }
 
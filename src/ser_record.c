@@ -0,0 +1,515 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2026 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* $Id$ */
+
+/*
+ * Serial traffic recorder and replayer
+ *
+ * -P record:<file>:<port> opens <port> with the platform serial device and
+ * logs every open, setparams, send, recv, drain, DTR/RTS and close event
+ * with a timestamp to <file>. The log file name must not contain a colon.
+ *
+ * -P replay:<file> serves a session from such a log without hardware. Data
+ * sent by the host are compared with the recording and received data are
+ * served from it. A recv() that the recording cannot satisfy before the
+ * host sends more times out like a silent programmer would; bytes recorded
+ * before a timeout are handed over as in the recording. Replay does not
+ * pace the responses, so the run time of a replay is the host-side cost of
+ * the upload. At the end, the number of round trips (a recv() after one or
+ * more send() calls) is compared with that of the recording.
+ *
+ * Log format: the 4-byte magic "ASL1" followed by events, each of which is
+ * a type byte, the time in us since the previous event and the payload
+ * length, both as unsigned LEB128 numbers, and then the payload.
+ */
+
+#include <ac_cfg.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "avrdude.h"
+#include "libavrdude.h"
+
+#define SERLOG_MAGIC "ASL1"
+
+enum {
+  SERLOG_OPEN = 'O',            // Payload: baud and cflags as LEB128 numbers
+  SERLOG_PARAMS = 'P',          // Payload: baud and cflags as LEB128 numbers
+  SERLOG_SEND = 'S',            // Payload: bytes sent
+  SERLOG_RECV = 'R',            // Payload: bytes received
+  SERLOG_TIMEOUT = 'T',         // Payload: number of requested bytes as LEB128
+  SERLOG_DRAIN = 'D',           // No payload
+  SERLOG_DTR = 'E',             // Payload: one byte, 1 for DTR/RTS on, 0 for off
+  SERLOG_CLOSE = 'C',           // No payload
+};
+
+static size_t put_uleb(unsigned char *p, uint64_t n) {
+  size_t len = 0;
+
+  do {
+    p[len++] = (n & 0x7f) | (n > 0x7f? 0x80: 0);
+    n >>= 7;
+  } while(n);
+
+  return len;
+}
+
+// Returns number of bytes consumed or 0 on malformed input
+static size_t get_uleb(const unsigned char *p, size_t avail, uint64_t *np) {
+  uint64_t n = 0;
+
+  for(size_t i = 0; i < avail && i < 10; i++) {
+    n |= (uint64_t) (p[i] & 0x7f) << 7*i;
+    if(!(p[i] & 0x80)) {
+      *np = n;
+      return i+1;
+    }
+  }
+
+  return 0;
+}
+
+
+// ---------------------------------------------------------------- Recorder
+
+static struct {
+  FILE *fp;
+  uint64_t last;                // Timestamp of previous event in us
+} rec;
+
+static void rec_event(int type, const unsigned char *data, size_t len) {
+  unsigned char hdr[21];
+  uint64_t now;
+  size_t n;
+
+  if(!rec.fp)
+    return;
+
+  now = avr_ustimestamp();
+  hdr[0] = type;
+  n = 1 + put_uleb(hdr+1, now - rec.last);
+  n += put_uleb(hdr+n, len);
+  rec.last = now;
+
+  if(fwrite(hdr, 1, n, rec.fp) != n || (len && fwrite(data, 1, len, rec.fp) != len)) {
+    pmsg_ext_error("cannot write serial log: %s\n", strerror(errno));
+    fclose(rec.fp);
+    rec.fp = NULL;
+  }
+}
+
+static void rec_params(int type, long baud, unsigned long cflags) {
+  unsigned char buf[20];
+  size_t n = put_uleb(buf, baud < 0? 0: baud);
+
+  n += put_uleb(buf+n, cflags);
+  rec_event(type, buf, n);
+}
+
+static int record_open(const char *port, union pinfo pinfo, union filedescriptor *fdp) {
+  const char *spec = port + strlen("record:"), *colon = strchr(spec, ':');
+
+  if(!str_starts(port, "record:") || !colon || colon == spec || !colon[1]) {
+    pmsg_error("port %s does not have the form record:<file>:<port>\n", port);
+    return -1;
+  }
+
+  if(!rec.fp) {                 // Keep log across rawclose() and reopen
+    char *fname = mmt_malloc(colon-spec+1);
+
+    memcpy(fname, spec, colon-spec);
+    if(!(rec.fp = fopen(fname, "wb")) || fwrite(SERLOG_MAGIC, 1, 4, rec.fp) != 4) {
+      pmsg_ext_error("cannot create serial log %s: %s\n", fname, strerror(errno));
+      if(rec.fp)
+        fclose(rec.fp);
+      rec.fp = NULL;
+      mmt_free(fname);
+      return -1;
+    }
+    pmsg_notice("recording serial traffic to %s\n", fname);
+    mmt_free(fname);
+    rec.last = avr_ustimestamp();
+  }
+
+  int rc = serial_serdev.open(colon+1, pinfo, fdp);
+  if(rc < 0) {                  // No session: drop the log and the record device
+    fclose(rec.fp);
+    rec.fp = NULL;
+    serdev = &serial_serdev;
+    return rc;
+  }
+  rec_params(SERLOG_OPEN, pinfo.serialinfo.baud, pinfo.serialinfo.cflags);
+
+  return rc;
+}
+
+static int record_setparams(const union filedescriptor *fd, long baud, unsigned long cflags) {
+  rec_params(SERLOG_PARAMS, baud, cflags);
+
+  return serial_serdev.setparams(fd, baud, cflags);
+}
+
+static void record_close(union filedescriptor *fd) {
+  rec_event(SERLOG_CLOSE, NULL, 0);
+  serial_serdev.close(fd);
+  if(rec.fp && fclose(rec.fp) != 0)
+    pmsg_ext_error("cannot close serial log: %s\n", strerror(errno));
+  rec.fp = NULL;
+  serdev = &serial_serdev;
+}
+
+static void record_rawclose(union filedescriptor *fd) {
+  rec_event(SERLOG_CLOSE, NULL, 0);
+  serial_serdev.rawclose(fd);
+}
+
+static int record_send(const union filedescriptor *fd, const unsigned char *buf, size_t buflen) {
+  rec_event(SERLOG_SEND, buf, buflen);
+
+  return serial_serdev.send(fd, buf, buflen);
+}
+
+/*
+ * The serial device recv() does not tell how many bytes arrived before a
+ * timeout, so read byte by byte against the deadline of the whole call and
+ * log bytes received before a timeout, so replay can reproduce partial reads
+ */
+static int record_recv(const union filedescriptor *fd, unsigned char *buf, size_t buflen) {
+  long timeout = serial_recv_timeout;
+  uint64_t deadline = avr_mstimestamp() + timeout, now;
+  int rc = 0;
+  size_t n;
+
+  for(n = 0; n < buflen; n++) {
+    now = avr_mstimestamp();
+    serial_recv_timeout = now < deadline? deadline - now: 0;
+    if((rc = serial_serdev.recv(fd, buf+n, 1)) < 0)
+      break;
+  }
+  serial_recv_timeout = timeout;
+
+  if(n)
+    rec_event(SERLOG_RECV, buf, n);
+  if(rc < 0) {
+    unsigned char req[10];
+    rec_event(SERLOG_TIMEOUT, req, put_uleb(req, buflen));
+  }
+
+  return rc;
+}
+
+static int record_drain(const union filedescriptor *fd, int display) {
+  rec_event(SERLOG_DRAIN, NULL, 0);
+
+  return serial_serdev.drain(fd, display);
+}
+
+static int record_set_dtr_rts(const union filedescriptor *fd, int is_on) {
+  unsigned char on = !!is_on;
+
+  rec_event(SERLOG_DTR, &on, 1);
+
+  return serial_serdev.set_dtr_rts(fd, is_on);
+}
+
+struct serial_device record_serdev = {
+  .open = record_open,
+  .setparams = record_setparams,
+  .close = record_close,
+  .rawclose = record_rawclose,
+  .send = record_send,
+  .recv = record_recv,
+  .drain = record_drain,
+  .set_dtr_rts = record_set_dtr_rts,
+  .flags = SERDEV_FL_CANSETSPEED,
+};
+
+
+// ---------------------------------------------------------------- Replayer
+
+typedef struct {
+  int type;                     // SERLOG_...
+  uint64_t us;                  // Time since previous event
+  size_t len;                   // Payload length
+  const unsigned char *data;    // Payload pointing into rpl.log
+} Serlog_event;
+
+static struct {
+  char *fname;
+  unsigned char *log;           // Contents of log file
+  Serlog_event *ev;             // Parsed events
+  int nev, pos;                 // Number of events and index of next unconsumed event
+  size_t off;                   // Bytes already consumed of current send/recv event
+  unsigned char *in;            // Recorded bytes received but not yet read by the host
+  size_t nin, szin;
+  bool sent;                    // Host sent data since its last recv()
+  int ntrips, rec_trips;        // Round trips in this replay and in the recording
+  uint64_t rec_us, start_us;    // Duration of recording, start of replay
+} rpl;
+
+static void rpl_free(void) {
+  mmt_free(rpl.fname);
+  mmt_free(rpl.log);
+  mmt_free(rpl.ev);
+  mmt_free(rpl.in);
+  memset(&rpl, 0, sizeof rpl);
+}
+
+static int rpl_load(const char *fname) {
+  FILE *fp = fopen(fname, "rb");
+  size_t size = 0, cap = 0, n;
+  int nev = 0, cev = 0;
+  bool sent = false;
+
+  if(!fp) {
+    pmsg_ext_error("cannot open serial log %s: %s\n", fname, strerror(errno));
+    return -1;
+  }
+  do {                          // Read whole file
+    if(size == cap)
+      rpl.log = mmt_realloc(rpl.log, cap = cap? 2*cap: 65536);
+    n = fread(rpl.log+size, 1, cap-size, fp);
+    size += n;
+  } while(n > 0);
+  fclose(fp);
+
+  if(size < 4 || memcmp(rpl.log, SERLOG_MAGIC, 4)) {
+    pmsg_error("%s is not a serial log\n", fname);
+    return -1;
+  }
+
+  for(size_t i = 4; i < size; ) {
+    uint64_t us, len;
+    size_t m, k;
+
+    if(!(m = get_uleb(rpl.log+i+1, size-i-1, &us)) ||
+      !(k = get_uleb(rpl.log+i+1+m, size-i-1-m, &len)) || len > size-i-1-m-k) {
+      pmsg_error("serial log %s is truncated at offset %lu\n", fname, (unsigned long) i);
+      return -1;
+    }
+    if(nev == cev)
+      rpl.ev = mmt_realloc(rpl.ev, (cev = cev? 2*cev: 1024) * sizeof *rpl.ev);
+    rpl.ev[nev].type = rpl.log[i];
+    rpl.ev[nev].us = us;
+    rpl.ev[nev].len = len;
+    rpl.ev[nev].data = rpl.log+i+1+m+k;
+
+    switch(rpl.log[i]) {
+    case SERLOG_SEND:
+      sent = true;
+      break;
+    case SERLOG_RECV: case SERLOG_TIMEOUT:
+      rpl.rec_trips += sent;
+      sent = false;
+      break;
+    }
+    rpl.rec_us += us;
+    nev++;
+    i += 1+m+k+len;
+  }
+  rpl.nev = nev;
+  rpl.fname = mmt_strdup(fname);
+
+  return 0;
+}
+
+static const Serlog_event *rpl_peek(void) {
+  return rpl.pos < rpl.nev? rpl.ev + rpl.pos: NULL;
+}
+
+static void rpl_next(void) {
+  rpl.pos++;
+  rpl.off = 0;
+}
+
+// Consume the next event if it is of the given type
+static void rpl_match(int type) {
+  const Serlog_event *e = rpl_peek();
+
+  if(e && e->type == type)
+    rpl_next();
+}
+
+// Move unread recorded device output into the receive queue
+static void rpl_queue(const Serlog_event *e) {
+  size_t n = e->len - rpl.off;
+
+  if(rpl.nin + n > rpl.szin)
+    rpl.in = mmt_realloc(rpl.in, rpl.szin = 2*(rpl.nin+n));
+  memcpy(rpl.in + rpl.nin, e->data + rpl.off, n);
+  rpl.nin += n;
+  rpl_next();
+}
+
+static int replay_open(const char *port, union pinfo pinfo, union filedescriptor *fdp) {
+  const char *fname = port + strlen("replay:");
+
+  if(!str_starts(port, "replay:") || !*fname) {
+    pmsg_error("port %s does not have the form replay:<file>\n", port);
+    return -1;
+  }
+
+  if(!rpl.log) {                // Keep state across rawclose() and reopen
+    if(rpl_load(fname) < 0) {
+      rpl_free();
+      return -1;
+    }
+    pmsg_notice("replaying %d serial events from %s\n", rpl.nev, fname);
+    rpl.start_us = avr_ustimestamp();
+  }
+  rpl_match(SERLOG_OPEN);
+  fdp->ifd = -1;
+
+  return 0;
+}
+
+static int replay_setparams(const union filedescriptor *fd, long baud, unsigned long cflags) {
+  rpl_match(SERLOG_PARAMS);
+
+  return 0;
+}
+
+static void replay_rawclose(union filedescriptor *fd) {
+  rpl_match(SERLOG_CLOSE);
+}
+
+static void replay_close(union filedescriptor *fd) {
+  rpl_match(SERLOG_CLOSE);
+
+  if(rpl.log) {
+    pmsg_notice("replay of %s: %d round trips in %.3f s (recording: %d round trips in %.3f s)\n",
+      rpl.fname, rpl.ntrips, (avr_ustimestamp() - rpl.start_us)/1e6, rpl.rec_trips, rpl.rec_us/1e6);
+    if(rpl.ntrips > rpl.rec_trips)
+      pmsg_warning("replay needed %d more round trips than the recording\n", rpl.ntrips - rpl.rec_trips);
+    if(rpl.pos < rpl.nev)
+      pmsg_notice("replay stopped at event %d of %d\n", rpl.pos, rpl.nev);
+  }
+  rpl_free();
+  serdev = &serial_serdev;
+}
+
+static int replay_send(const union filedescriptor *fd, const unsigned char *buf, size_t buflen) {
+  const Serlog_event *e;
+
+  if(verbose > 3)
+    trace_buffer(__func__, buf, buflen);
+
+  rpl.sent = true;
+  while(buflen) {
+    if(!(e = rpl_peek())) {
+      pmsg_error("host sends %lu bytes more than recorded\n", (unsigned long) buflen);
+      return -1;
+    }
+    switch(e->type) {
+    case SERLOG_SEND: {
+      size_t n = e->len - rpl.off < buflen? e->len - rpl.off: buflen;
+
+      if(memcmp(e->data + rpl.off, buf, n)) {
+        for(size_t i = 0; i < n; i++)
+          if(e->data[rpl.off+i] != buf[i]) {
+            pmsg_error("sent 0x%02x differs from recorded 0x%02x at event %d, byte %lu\n",
+              buf[i], e->data[rpl.off+i], rpl.pos, (unsigned long) (rpl.off+i));
+            break;
+          }
+        return -1;
+      }
+      buf += n;
+      buflen -= n;
+      if((rpl.off += n) == e->len)
+        rpl_next();
+      break;
+    }
+    case SERLOG_RECV:           // Device output the host has not read yet
+      rpl_queue(e);
+      break;
+    default:                    // Timeouts and control events the host did not mirror
+      rpl_next();
+    }
+  }
+
+  return 0;
+}
+
+static int replay_recv(const union filedescriptor *fd, unsigned char *buf, size_t buflen) {
+  const Serlog_event *e;
+
+  rpl.ntrips += rpl.sent;
+  rpl.sent = false;
+
+  while(rpl.nin < buflen) {
+    if(!(e = rpl_peek()) || e->type == SERLOG_SEND) // Device waits for host input
+      goto timeout;
+    if(e->type == SERLOG_RECV) {
+      rpl_queue(e);
+    } else {
+      rpl_next();
+      if(e->type == SERLOG_TIMEOUT)
+        goto timeout;
+    }
+  }
+
+  memcpy(buf, rpl.in, buflen);
+  memmove(rpl.in, rpl.in + buflen, rpl.nin - buflen);
+  rpl.nin -= buflen;
+
+  if(verbose > 3)
+    trace_buffer(__func__, buf, buflen);
+
+  return 0;
+
+timeout:                        // Hand over bytes that arrived before the timeout
+  memcpy(buf, rpl.in, rpl.nin < buflen? rpl.nin: buflen);
+  rpl.nin = 0;                  // A failed read swallows pending bytes
+  pmsg_notice2("replay_recv(): programmer is not responding\n");
+  return -1;
+}
+
+static int replay_drain(const union filedescriptor *fd, int display) {
+  if(display) {
+    msg_info("drain>");
+    for(size_t i = 0; i < rpl.nin; i++)
+      msg_info("%02x ", rpl.in[i]);
+    msg_info("<drain\n");
+  }
+  rpl.nin = 0;
+  rpl_match(SERLOG_DRAIN);
+
+  return 0;
+}
+
+static int replay_set_dtr_rts(const union filedescriptor *fd, int is_on) {
+  rpl_match(SERLOG_DTR);
+
+  return 0;
+}
+
+struct serial_device replay_serdev = {
+  .open = replay_open,
+  .setparams = replay_setparams,
+  .close = replay_close,
+  .rawclose = replay_rawclose,
+  .send = replay_send,
+  .recv = replay_recv,
+  .drain = replay_drain,
+  .set_dtr_rts = replay_set_dtr_rts,
+  .flags = SERDEV_FL_CANSETSPEED,
+};
@@ -38,6 +38,7 @@
 
 long serial_recv_timeout = 5000; /* ms */
 long serial_drain_timeout = 250; /* ms */
+int serial_low_latency = 0;      /* Not supported, use the adapter's driver settings */
 
 #define W32SERBUFSIZE 1024
 
@@ -253,6 +254,14 @@ static int ser_open(const char *port, union pinfo pinfo, union filedescriptor *f
 		return net_open(port + strlen("net:"), fdp);
 	}
 
+	/*
+	 * Hand record:<file>:<port> and replay:<file> over to ser_record.c
+	 */
+	if (str_starts(port, "record:") || str_starts(port, "replay:")) {
+		serdev = str_starts(port, "record:")? &record_serdev: &replay_serdev;
+		return serdev->open(port, pinfo, fdp);
+	}
+
 	if (str_casestarts(port, "com")) {
 
 	    // prepend "\\\\.\\" to name, required for port # >= 10
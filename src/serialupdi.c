@@ -86,7 +86,11 @@ static int serialupdi_reset(const PROGRAMMER *pgm, reset_mode mode) {
 */
   switch (mode) {
     case APPLY_RESET:
+      // Let a page write still in progress complete rather than abort it
+      if (updi_get_nvm_command(pgm) && updi_nvm_flush(pgm, updi_get_nvm_part(pgm)) < 0)
+        pmsg_warning("pending flash write may not have completed before reset\n");
       pmsg_debug("sending reset request\n");
+      updi_set_nvm_command(pgm, NULL, 0); // Reset clears NVMCTRL.CTRLA
       return updi_write_cs(pgm, UPDI_ASI_RESET_REQ, UPDI_RESET_REQ_VALUE);
     case RELEASE_RESET:
       pmsg_debug("sending release reset request\n");
@@ -593,6 +597,37 @@ static int serialupdi_write_userrow(const PROGRAMMER *pgm, const AVRPART *p, con
   return 0;
 }
 
+/*
+ * Raise the UPDI clock so the target can follow the line rate requested with
+ * -xfastbaud, then switch the host over; if the target does not answer at
+ * the new rate, go back to the one used so far
+ */
+static int serialupdi_speed_up(const PROGRAMMER *pgm) {
+  long baud = updi_get_fast_baud(pgm), old = pgm->baudrate? pgm->baudrate: 115200;
+  uint8_t clksel;
+
+  if (baud <= old) {
+    return 0;
+  }
+  clksel = baud <= 230400? UPDI_ASI_CTRLA_UPDICLKSEL_4M:
+    baud <= 460800? UPDI_ASI_CTRLA_UPDICLKSEL_8M: UPDI_ASI_CTRLA_UPDICLKSEL_16M;
+  pmsg_debug("setting UPDI clock select to 0x%02x\n", clksel);
+  if (updi_write_cs(pgm, UPDI_ASI_CTRLA, clksel) < 0) {
+    pmsg_error("setting UPDI clock failed\n");
+    return -1;
+  }
+  if (updi_link_set_baud(pgm, baud) == 0) {
+    pmsg_notice("UPDI link running at %ld baud\n", baud);
+    return 0;
+  }
+  pmsg_warning("no response at %ld baud, falling back to %ld baud\n", baud, old);
+  if (updi_link_set_baud(pgm, old) < 0 && updi_link_init(pgm) < 0) {
+    pmsg_error("UPDI link initialization failed\n");
+    return -1;
+  }
+  return 0;
+}
+
 static int serialupdi_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
   uint8_t value;
   uint8_t reset_link_required=0;
@@ -669,6 +704,10 @@ static int serialupdi_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
     return -1;
   }
 
+  if (updi_get_fast_baud(pgm) && serialupdi_speed_up(pgm) < 0) {
+    return -1;
+  }
+
   pmsg_notice("entering NVM programming mode\n");
 
   /* try, but ignore failure */
@@ -739,6 +778,9 @@ static int serialupdi_read_byte(const PROGRAMMER *pgm, const AVRPART *p, const A
     return 0;
   }
 
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   return updi_read_byte(pgm, mem->offset + addr, value);
 }
 
@@ -778,6 +820,9 @@ static int serialupdi_write_byte(const PROGRAMMER *pgm, const AVRPART *p, const
     Return("cannot write to read-only memory %s of %s", mem->desc, p->desc);
   }
 
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   return updi_write_byte(pgm, mem->offset + addr, value);
 }
 
@@ -791,28 +836,44 @@ static int serialupdi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
     return -1;
   }
 
-  if ((int) n_bytes > m->readsize) {
-    unsigned int read_offset = addr;
-    int remaining_bytes = n_bytes;
-    int read_bytes = 0;
-    int rc;
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
 
-    while (remaining_bytes > 0) {
-      rc = updi_read_data(pgm, m->offset + read_offset, m->buf + read_offset, 
-                          remaining_bytes > m->readsize ? m->readsize : remaining_bytes);
-      if (rc < 0) {
-        pmsg_error("paged load operation failed\n");
-        return rc;
-      } else {
-        read_bytes+=rc;
-        read_offset+=m->readsize;
-        remaining_bytes-=m->readsize;
-      }
-    }
-    return read_bytes;
+  int blocksize = m->readsize > 0 && m->readsize < UPDI_MAX_REPEAT_SIZE? m->readsize: UPDI_MAX_REPEAT_SIZE;
+  int rc;
+
+  /*
+   * Flash and boot row are read word-wise; a readsize at the byte REPEAT
+   * limit then allows the full 256-word REPEAT, smaller ones are rounded
+   * down so no block exceeds readsize bytes
+   */
+  if ((mem_is_in_flash(m) || mem_is_bootrow(m)) && blocksize > 1) {
+    int blockwords = blocksize < UPDI_MAX_REPEAT_SIZE? blocksize/2: UPDI_MAX_REPEAT_SIZE;
+    rc = updi_read_data_words_blocks(pgm, m->offset + addr, m->buf + addr, n_bytes, blockwords);
   } else {
-    return updi_read_data(pgm, m->offset + addr, m->buf + addr, n_bytes);
+    rc = updi_read_data_blocks(pgm, m->offset + addr, m->buf + addr, n_bytes, blocksize);
   }
+
+  if (rc < 0) {
+    pmsg_error("paged load operation failed\n");
+  }
+  return rc;
+}
+
+/*
+ * UPDI flash page writes only ever clear bits, so once a chip erase has left
+ * the flash blank a page of all 0xff need not be sent at all
+ */
+static int serialupdi_write_flash(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+                                  unsigned int addr, unsigned int n_bytes)
+{
+  if (updi_get_flash_erased(pgm) && memall(m->buf + addr, 0xff, n_bytes)) {
+    pmsg_debug("skipping blank flash page at 0x%04X\n", addr);
+    return 0;
+  }
+  updi_flash_written(pgm, m->offset + addr, n_bytes);
+  return updi_nvm_write_flash(pgm, p, m->offset + addr, m->buf + addr, n_bytes);
 }
 
 static int serialupdi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
@@ -836,8 +897,8 @@ static int serialupdi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
         rc = updi_nvm_write_eeprom(pgm, p, m->offset + write_offset, m->buf + write_offset, 
                                    remaining_bytes > m->page_size ? m->page_size : remaining_bytes);
       } else if (mem_is_flash(m)) {
-        rc = updi_nvm_write_flash(pgm, p, m->offset + write_offset, m->buf + write_offset, 
-                                  remaining_bytes > m->page_size ? m->page_size : remaining_bytes);
+        rc = serialupdi_write_flash(pgm, p, m, write_offset,
+                                    remaining_bytes > m->page_size ? m->page_size : remaining_bytes);
       } else if (mem_is_userrow(m)) {
         rc = serialupdi_write_userrow(pgm, p, m, page_size, write_offset, 
                                       remaining_bytes > m->page_size ? m->page_size : remaining_bytes);
@@ -863,7 +924,7 @@ static int serialupdi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
     if (mem_is_eeprom(m)) {
       rc = updi_nvm_write_eeprom(pgm, p, m->offset+addr, m->buf+addr, n_bytes);
     } else if (mem_is_flash(m)) {
-      rc = updi_nvm_write_flash(pgm, p, m->offset+addr, m->buf+addr, n_bytes);
+      rc = serialupdi_write_flash(pgm, p, m, addr, n_bytes);
     } else if (mem_is_userrow(m)) {
       rc = serialupdi_write_userrow(pgm, p, m, page_size, addr, n_bytes);
     } else if (mem_is_fuses(m)) {
@@ -877,6 +938,19 @@ static int serialupdi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
   }
 }
 
+// Complete a flash write that was left running by the last paged write
+static int serialupdi_end_programming(const PROGRAMMER *pgm, const AVRPART *p) {
+  return updi_nvm_flush(pgm, p);
+}
+
+// Let CRCSCAN check flash written once after a chip erase if requested by -xcrcverify
+static int serialupdi_crc_verify(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m) {
+  if (!updi_get_crc_verify(pgm) || !updi_get_flash_erased(pgm)) {
+    return 0;
+  }
+  return avr_crcscan_verify(pgm, p, m);
+}
+
 static int serialupdi_unlock(const PROGRAMMER *pgm, const AVRPART *p) {
 /*
     def unlock(self):
@@ -947,6 +1021,7 @@ static int serialupdi_unlock(const PROGRAMMER *pgm, const AVRPART *p) {
 
 static int serialupdi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
   uint8_t value;
+  int rc;
 
   if (updi_read_cs(pgm, UPDI_ASI_SYS_STATUS, &value)<0) {
     pmsg_error("read CS operation during chip erase failed\n");
@@ -957,12 +1032,17 @@ static int serialupdi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
     pmsg_warning("device is locked\n");
     if (ovsigck) {
       pmsg_warning("attempting device erase\n");
-      return serialupdi_unlock(pgm, p);
+      rc = serialupdi_unlock(pgm, p);
+    } else {
+      rc = -1;
     }
   } else {
-    return updi_nvm_chip_erase(pgm, p);
+    rc = updi_nvm_chip_erase(pgm, p);
   }
-  return -1;
+  if (rc >= 0) {
+    updi_set_flash_erased(pgm, 1);
+  }
+  return rc;
 }
 
 static int serialupdi_page_erase(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
@@ -1007,6 +1087,7 @@ static int serialupdi_parseextparms(const PROGRAMMER *pgm, const LISTID extparms
   LNODEID ln;
   const char *extended_param;
   char rts_mode[5];
+  long fast_baud;
   int rv = 0;
 
   for (ln = lfirst(extparms); ln; ln = lnext(ln)) {
@@ -1023,9 +1104,32 @@ static int serialupdi_parseextparms(const PROGRAMMER *pgm, const LISTID extparms
       }
       continue;
     }
+    if (str_eq(extended_param, "lowlatency")) {
+      serial_low_latency = 1;
+      continue;
+    }
+    if (str_eq(extended_param, "fastbaud")) {
+      updi_set_fast_baud(pgm, 460800);
+      continue;
+    }
+    if (sscanf(extended_param, "fastbaud=%ld", &fast_baud) == 1) {
+      if (fast_baud <= 0) {
+        pmsg_error("invalid baud rate in -x%s\n", extended_param);
+        return -1;
+      }
+      updi_set_fast_baud(pgm, fast_baud);
+      continue;
+    }
+    if (str_eq(extended_param, "crcverify")) {
+      updi_set_crc_verify(pgm, 1);
+      continue;
+    }
     if (str_eq(extended_param, "help")) {
       msg_error("%s -c %s extended options:\n", progname, pgmid);
       msg_error("  -xrtsdtr=low,high Force RTS/DTR lines low or high state during programming\n");
+      msg_error("  -xlowlatency      Set USB-serial adapter latency timer to 1 ms\n");
+      msg_error("  -xfastbaud[=<b>]  Switch to <b> baud (default 460800) after reading the SIB\n");
+      msg_error("  -xcrcverify       Verify flash with the CRCSCAN peripheral, read back on mismatch\n");
       msg_error("  -xhelp            Show this help menu and exit\n");
       return LIBAVRDUDE_EXIT;;
     }
@@ -1039,6 +1143,7 @@ static int serialupdi_parseextparms(const PROGRAMMER *pgm, const LISTID extparms
 
 void serialupdi_initpgm(PROGRAMMER *pgm) {
   strcpy(pgm->type, "serialupdi");
+  pgm->paged_max = 65535;       // Limit of paged r/w
 
   /*
    * mandatory functions
@@ -1067,6 +1172,8 @@ void serialupdi_initpgm(PROGRAMMER *pgm) {
   pgm->read_sib       = serialupdi_read_sib;
   pgm->paged_load     = serialupdi_paged_load;
   pgm->page_erase     = serialupdi_page_erase;
+  pgm->end_programming= serialupdi_end_programming;
+  pgm->crc_verify     = serialupdi_crc_verify;
   pgm->setup          = serialupdi_setup;
   pgm->teardown       = serialupdi_teardown;
 
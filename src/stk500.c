@@ -782,9 +782,15 @@ static int stk500_parseextparms(const PROGRAMMER *pgm, const LISTID extparms)
       }
     }
 
+    else if (str_eq(extended_param, "lowlatency")) {
+      serial_low_latency = 1;
+      continue;
+    }
+
     else if (str_eq(extended_param, "help")) {
       msg_error("%s -c %s extended options:\n", progname, pgmid);
       msg_error("  -xattempts=<arg>      Specify no. connection retry attempts\n");
+      msg_error("  -xlowlatency          Set USB-serial adapter latency timer to 1 ms\n");
       if (pgm->extra_features & HAS_VTARG_READ) {
         msg_error("  -xvtarg               Read target supply voltage\n");
       }
@@ -878,9 +884,12 @@ static int stk500_open(PROGRAMMER *pgm, const char *port) {
    */
   stk500_drain(pgm, 0);
 
-  // MIB510 init
-  if (str_eq(pgmid, "mib510") && mib510_isp(pgm, 1) != 0)
-    return -1;
+  // MIB510 init; it writes fixed 256-byte blocks, so give it one page per paged_write() call
+  if (str_eq(pgmid, "mib510")) {
+    pgm->paged_max = 0;
+    if (mib510_isp(pgm, 1) != 0)
+      return -1;
+  }
 
   if (stk500_getsync(pgm) < 0)
     return -1;
@@ -1020,7 +1029,7 @@ static int stk500_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVR
                               unsigned int page_size,
                               unsigned int addr, unsigned int n_bytes)
 {
-  unsigned char* buf = alloca(page_size + 16);
+  unsigned char* buf = alloca((page_size < 256? 256: page_size) + 16); // MIB510: 256-byte blocks
   int memchr;
   int a_div;
   int block_size;
@@ -1589,6 +1598,7 @@ const char stk500_desc[] = "Atmel STK500 Version 1.x firmware";
 
 void stk500_initpgm(PROGRAMMER *pgm) {
   strcpy(pgm->type, "STK500");
+  pgm->paged_max = 65535;       // Paged r/w loop over pages, so can do several
 
   /*
    * mandatory functions
@@ -1892,6 +1892,16 @@ static int stk500v2_parseextparms(const PROGRAMMER *pgm, const LISTID extparms)
       }
     }
 
+    else if (str_eq(extended_param, "lowlatency")) {
+      if (pgm->conntype != CONNTYPE_SERIAL) {
+        pmsg_error("-xlowlatency only applies to serial connections\n");
+        rv = -1;
+        break;
+      }
+      serial_low_latency = 1;
+      continue;
+    }
+
     else if (str_eq(extended_param, "help")) {
       msg_error("%s -c %s extended options:\n", progname, pgmid);
       if (pgm->extra_features & HAS_VTARG_ADJ) {
@@ -1917,6 +1927,8 @@ static int stk500v2_parseextparms(const PROGRAMMER *pgm, const LISTID extparms)
         msg_error("  -xfosc=<arg>[M|k]|off Set oscillator clock frequency\n");
       }
       msg_error("  -xxtal=<arg>[M|k]     Set programmer xtal frequency\n");
+      if (pgm->conntype == CONNTYPE_SERIAL)
+        msg_error("  -xlowlatency          Set USB-serial adapter latency timer to 1 ms\n");
       msg_error("  -xhelp                Show this help menu and exit\n");
       return LIBAVRDUDE_EXIT;;
     }
@@ -2833,6 +2845,13 @@ static int stk500v2_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
 
     DEBUG("block_size at addr %d is %d\n",addr,block_size);
 
+    // Do not send request to write empty flash pages except for bootloaders (fixes Issue #425)
+    unsigned char *p = m->buf+addr;
+    if(!(pgm->prog_modes & PM_SPM) && addrshift && *p == 0xff && !memcmp(p, p+1, block_size-1)) {
+      last_addr = UINT_MAX;     // Programmer address does not advance: load it for the next page
+      continue;
+    }
+
     memcpy(buf,commandbuf,sizeof(commandbuf));
 
     buf[1] = block_size >> 8;
@@ -2846,10 +2865,7 @@ static int stk500v2_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const A
 
     memcpy(buf+10,m->buf+addr, block_size);
 
-    // Do not send request to write empty flash pages except for bootloaders (fixes Issue #425)
-    unsigned char *p = m->buf+addr;
-    result = (pgm->prog_modes & PM_SPM) || !addrshift || *p != 0xff || memcmp(p, p+1, block_size-1)?
-      stk500v2_command(pgm, buf, block_size+10, sizeof buf): 0;
+    result = stk500v2_command(pgm, buf, block_size+10, sizeof buf);
 
     if (result < 0) {
       pmsg_error("write command failed\n");
@@ -4875,6 +4891,7 @@ const char stk500v2_desc[] = "Atmel STK500 Version 2.x firmware";
 
 void stk500v2_initpgm(PROGRAMMER *pgm) {
   strcpy(pgm->type, "STK500V2");
+  pgm->paged_max = 65535;       // Paged r/w loop over pages, so can do several
 
   /*
    * mandatory functions
@@ -475,6 +475,49 @@ int memall(const void *p, char c, size_t n) {
   return n <= 0 || (*q == c && memcmp(q, q+1, n-1) == 0);
 }
 
+/*
+ * Return index of the last of n bytes pointed to by p that is not c, or -1 if
+ * all are c; compares eight bytes at a time, which compilers vectorise
+ */
+long memrnot(const void *p, char c, size_t n) {
+  const unsigned char *q = (const unsigned char *) p;
+  uint64_t cc = (unsigned char) c * 0x0101010101010101ULL, w;
+
+  for(; n % 8; n--)
+    if(q[n-1] != (unsigned char) c)
+      return n-1;
+  for(; n; n -= 8) {
+    memcpy(&w, q+n-8, 8);
+    if(w != cc)
+      break;
+  }
+  for(; n; n--)
+    if(q[n-1] != (unsigned char) c)
+      return n-1;
+
+  return -1;
+}
+
+// Return 1 if each of the n bytes of s1 is the bitwise and of those in s2 and s3, 0 otherwise
+int memisand(const void *s1, const void *s2, const void *s3, size_t n) {
+  const unsigned char *q1 = s1, *q2 = s2, *q3 = s3;
+  uint64_t w1, w2, w3;
+  size_t i;
+
+  for(i = 0; i + 8 <= n; i += 8) {
+    memcpy(&w1, q1+i, 8);
+    memcpy(&w2, q2+i, 8);
+    memcpy(&w3, q3+i, 8);
+    if(w1 != (w2 & w3))
+      return 0;
+  }
+  for(; i < n; i++)
+    if(q1[i] != (q2[i] & q3[i]))
+      return 0;
+
+  return 1;
+}
+
 
 // https://en.wikipedia.org/wiki/Easter_egg_(media)#Software
 unsigned long long int easteregg(const char *str, const char **endpp) {
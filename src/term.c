@@ -332,6 +332,11 @@ static int cmd_dump(const PROGRAMMER *pgm, const AVRPART *p, int argc, const cha
   if(argc < 4 && verbose)
     term_out(">>> %s %s 0x%x 0x%x\n", cmd, read_mem[i].mem->desc, read_mem[i].addr, read_mem[i].len);
 
+  // Fetch whole pages in one go; errors are reported by the bytewise reads below
+  avr_prefetch_cached(pgm, p, read_mem[i].mem, read_mem[i].addr, read_mem[i].len);
+  if(read_mem[i].addr + read_mem[i].len > mem->size) // Wraps around
+    avr_prefetch_cached(pgm, p, read_mem[i].mem, 0, read_mem[i].addr + read_mem[i].len - mem->size);
+
   report_progress(0, 1, "Reading");
   for (int j = 0; j < read_mem[i].len; j++) {
     int addr = (read_mem[i].addr + j) % mem->size;
@@ -600,6 +605,7 @@ static int cmd_write(const PROGRAMMER *pgm, const AVRPART *p, int argc, const ch
     msg_notice2("; remaining space filled with %s", argv[argc - 2]);
   msg_notice2("\n");
 
+  avr_prefetch_cached(pgm, p, mem, addr, len + bytes_grown);
   report_progress(0, 1, avr_has_paged_access(pgm, mem)? "Caching": "Writing");
   for (i = 0; i < len + bytes_grown; i++) {
     report_progress(i, len + bytes_grown, NULL);
@@ -715,6 +721,8 @@ static int cmd_save(const PROGRAMMER *pgm, const AVRPART *p, int argc, const cha
   }
 
   // Read memory from device/cache
+  for(int i = 0; i < n; i++)
+    avr_prefetch_cached(pgm, p, mem, seglist[i].addr, seglist[i].len);
   report_progress(0, 1, "Reading");
   for(int i = 0; i < n; i++) {
     for(int j = seglist[i].addr; j < seglist[i].addr + seglist[i].len; j++) {
@@ -804,6 +812,7 @@ static int cmd_send(const PROGRAMMER *pgm, const AVRPART *p, int argc, const cha
   led_set(pgm, LED_PGM);
 
   rc = spi_mode? pgm->spi(pgm, cmd, res, argc-1): pgm->cmd(pgm, cmd, res);
+  avr_forget_byte_cache(pgm);   // Raw commands might have changed fuses or lock
 
   if(rc < 0)
     led_set(pgm, LED_ERR);
@@ -1014,7 +1023,7 @@ static int getfusel(const PROGRAMMER *pgm, const AVRPART *p, Fusel_t *fl, const
 
   fl_t m = {.i = 0};
   for(int i=0; i<mem->size; i++)
-    if(led_read_byte(pgm, p, mem, i, m.b+i) < 0) {
+    if(pgm->read_byte_cached(pgm, p, mem, i, m.b+i) < 0) {
       err = cache_string(tofree = str_sprintf("cannot read %s's %s memory", p->desc, mem->desc));
       free(tofree);
       goto back;
@@ -1543,7 +1552,7 @@ static int cmd_config(const PROGRAMMER *pgm, const AVRPART *p, int argc, const c
 
   if(towrite.i != fusel.current) {
     for(int i=0; i<mem->size; i++)
-      if(led_write_byte(pgm, p, mem, i, towrite.b[i]) < 0) {
+      if(pgm->write_byte_cached(pgm, p, mem, i, towrite.b[i]) < 0) {
         pmsg_error("(config) cannot write to %s's %s memory\n", p->desc, mem->desc);
         ret = -1;
         goto finished;
@@ -1579,14 +1588,14 @@ static int fusel_factory(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *
   // Read in memory as little endian
   for(int i=0; i<mem->size; i++) {
     value[i] = mem->initval >> (8*i);
-    if(led_read_byte(pgm, p, mem, i, current+i) < 0)
+    if(pgm->read_byte_cached(pgm, p, mem, i, current+i) < 0)
       current[i] = ~value[i];
   }
 
   // Update memory if needed
   for(int i=0; i<mem->size; i++) {
     if(current[i] != value[i]) {
-      if(led_write_byte(pgm, p, mem, i, value[i]) < 0) {
+      if(pgm->write_byte_cached(pgm, p, mem, i, value[i]) < 0) {
         pmsg_warning("(factory) cannot write to %s memory\n", mem->desc);
         return -1;
       }
@@ -37,7 +37,7 @@
 /*
  * Parsing of [<memory>:<op>:<file>[:<fmt>] | <file>[:<fmt>]]
  *
- * As memory names don't contain colons and the r/w/v operation <op> is
+ * As memory names don't contain colons and the r/w/v/d operation <op> is
  * a single character, check whether the first two colons sandwich one
  * character. If not, treat the argument as a filename (defaulting to
  * flash write). This allows colons in filenames other than those for
@@ -53,9 +53,9 @@ UPDATE *parse_op(const char *s) {
   // Check for <memory>:c: start in which case override defaults
   const char *fc = strchr(s, ':');
   if(fc && fc[1] && fc[2] == ':') {
-    if(!strchr("rwv", fc[1])) {
+    if(!strchr("rwvd", fc[1])) {
       pmsg_error("invalid I/O mode :%c: in -U %s\n", fc[1], s);
-      imsg_error("I/O mode can be r, w or v for read, write or verify device\n");
+      imsg_error("I/O mode can be r, w, v or d for read, write, verify or differential write\n");
       free(upd->memstr);
       free(upd);
       return NULL;
@@ -64,7 +64,8 @@ UPDATE *parse_op(const char *s) {
     upd->memstr = memcpy(cfg_malloc(__func__, fc-s+1), s, fc-s);
     upd->op =
       fc[1]=='r'? DEVICE_READ:
-      fc[1]=='w'? DEVICE_WRITE: DEVICE_VERIFY;
+      fc[1]=='w'? DEVICE_WRITE:
+      fc[1]=='d'? DEVICE_DIFFWRITE: DEVICE_VERIFY;
     fn = fc+3;
   }
 
@@ -101,6 +102,7 @@ UPDATE *dup_update(const UPDATE *upd) {
   memcpy(u, upd, sizeof*u);
   u->memstr = upd->memstr? cfg_strdup(__func__, upd->memstr): NULL;
   u->filename = cfg_strdup(__func__, upd->filename);
+  u->basefile = upd->basefile? cfg_strdup(__func__, upd->basefile): NULL;
 
   return u;
 }
@@ -126,6 +128,7 @@ void free_update(UPDATE *u) {
   if(u) {
     free(u->memstr);
     free(u->filename);
+    free(u->basefile);
     memset(u, 0, sizeof *u);
     free(u);
   }
@@ -137,7 +140,7 @@ char *update_str(const UPDATE *upd) {
       str_eq("interactive terminal", upd->cmdline)? 't': 'T', upd->cmdline);
   return str_sprintf("-U %s:%c:%s:%c",
     upd->memstr,
-    upd->op == DEVICE_READ? 'r': upd->op == DEVICE_WRITE? 'w': 'v',
+    upd->op == DEVICE_READ? 'r': upd->op == DEVICE_WRITE? 'w': upd->op == DEVICE_DIFFWRITE? 'd': 'v',
     upd->filename,
     fileio_fmtchr(upd->format));
 }
@@ -167,41 +170,37 @@ int memstats(const AVRPART *p, const char *memstr, int size, Filestats *fsp) {
   }
 
   ret.lastaddr = -1;
-  int firstset = 0, insection = 0;
-  // Scan all memory
-  for(int addr = 0; addr < mem->size; ) {
-    int pageset = 0;
-    // Go page by page
-    for(int pgi = 0; pgi < pgsize; pgi++, addr++) {
-      if(mem->tags[addr] & TAG_ALLOCATED) {
-        if(!firstset) {
-          firstset = 1;
-          ret.firstaddr = addr;
+  int lastpage = -1;
+  // Visit allocated sections [beg, end) only
+  for(int beg = avr_mem_next_allocated(mem, 0, mem->size); beg < mem->size;
+      beg = avr_mem_next_allocated(mem, beg, mem->size)) {
+    int end = avr_mem_next_hole(mem, beg, mem->size);
+
+    if(ret.lastaddr < 0)
+      ret.firstaddr = beg;
+    ret.lastaddr = end-1;
+    // size can be smaller than tags suggest owing to flash trailing-0xff
+    int inend = end < size? end: size;
+    if(beg < inend) {
+      ret.nbytes += inend - beg;
+      ret.nsections++;
+      // Pages touched by the section: fill is what remains unset in them
+      for(int addr = beg; addr < inend; ) {
+        int page = addr/pgsize, pgend = (page+1)*pgsize;
+        if(pgend > inend)
+          pgend = inend;
+        if(page != lastpage) {
+          lastpage = page;
+          ret.npages++;
+          ret.nfill += (page+1)*pgsize <= mem->size? pgsize: mem->size - page*pgsize;
         }
-        ret.lastaddr = addr;
-        // size can be smaller than tags suggest owing to flash trailing-0xff
-        if(addr < size) {
-          ret.nbytes++;
-          if(!pageset) {
-            pageset = 1;
-            ret.nfill += pgi;
-            ret.npages++;
-          }
-          if(!insection) {
-            insection = 1;
-            ret.nsections++;
-          }
-        } else {                // Now beyond size returned by input file read
-          ret.ntrailing++;
-          if(pageset)
-            ret.nfill++;
-        }
-      } else {                  // In a hole or beyond input file
-        insection = 0;
-        if(pageset)
-          ret.nfill++;
+        ret.nfill -= pgend - addr;
+        addr = pgend;
       }
     }
+    if(end > inend)             // Beyond size returned by input file read
+      ret.ntrailing += end - (beg > inend? beg: inend);
+    beg = end;
   }
 
   if(fsp)
@@ -290,7 +289,7 @@ int update_dryrun(const AVRPART *p, UPDATE *upd) {
 
   known = 0;
   // Necessary to check whether the file is readable?
-  if(upd->op == DEVICE_VERIFY || upd->op == DEVICE_WRITE || upd->format == FMT_AUTO) {
+  if(upd->op == DEVICE_VERIFY || upd->op == DEVICE_WRITE || upd->op == DEVICE_DIFFWRITE || upd->format == FMT_AUTO) {
     if(upd->format != FMT_IMM) {
       // Need to read the file: was it written before, so will be known?
       for(int i = 0; i < nfwritten; i++)
@@ -348,6 +347,14 @@ int update_dryrun(const AVRPART *p, UPDATE *upd) {
     }
     break;
 
+  case DEVICE_DIFFWRITE:
+    errno = 0;
+    if(upd->basefile && !update_is_readable(upd->basefile)) {
+      pmsg_ext_error("reference image %s is not readable: %s\n", upd->basefile, strerror(errno));
+      ret = LIBAVRDUDE_GENERAL_FAILURE;
+    }
+    break;
+
   case DEVICE_VERIFY:           // Already checked that file is readable
   case DEVICE_WRITE:
     break;
@@ -361,6 +368,28 @@ int update_dryrun(const AVRPART *p, UPDATE *upd) {
 }
 
 
+/*
+ * Read the -R reference image of the memory of upd: that is what an earlier
+ * upload left on the device, with 0xff where that file had no data
+ */
+static AVRMEM *read_base_image(const AVRPART *p, const UPDATE *upd) {
+  AVRPART *bp = avr_dup_part(p);
+  AVRMEM *bm, *img = NULL;
+
+  if(fileio(FIO_READ, upd->basefile, upd->basefmt, bp, upd->memstr, -1) >= 0 &&
+    (bm = avr_locate_mem(bp, upd->memstr))) {
+    img = avr_dup_mem(bm);
+    for(int i = 0; i < img->size; i++)
+      if(!(img->tags[i] & TAG_ALLOCATED))
+        img->buf[i] = 0xff;
+    memset(img->tags, TAG_ALLOCATED, img->size);
+  }
+  avr_free_part(bp);
+
+  return img;
+}
+
+
 int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updateflags flags) {
   AVRPART *v;
   AVRMEM *mem;
@@ -426,6 +455,7 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
     break;
 
   case DEVICE_WRITE:
+  case DEVICE_DIFFWRITE:
     // Write the selected device memory using data from a file
 
     rc = fileio(FIO_READ, upd->filename, upd->format, p, upd->memstr, -1);
@@ -490,6 +520,78 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
     pmsg_info("writing %d byte%s %s%s ...\n", fs.nbytes,
       str_plural(fs.nbytes), mem->desc, alias_mem_desc);
 
+    if (!(flags & UF_NOWRITE) && upd->op == DEVICE_DIFFWRITE && avr_has_paged_access(pgm, mem)) {
+      // Only write pages that differ from the device; flushing the cache reads them back
+      int npages, dsize = size > fs.lastaddr+1? size: fs.lastaddr+1; // Include trailing 0xff
+      AVRMEM *img = NULL;
+
+      if(upd->basefile) {       // Trust the reference image without reading the device
+        if(!(img = read_base_image(p, upd))) {
+          pmsg_error("read from reference image %s failed\n", upd->basefile);
+          return LIBAVRDUDE_GENERAL_FAILURE;
+        }
+        pmsg_info("comparing with reference image %s\n", upd->basefile);
+        if(upd->padbase) {      // As after a chip erase, bytes without input are 0xff up to the reference end
+          int end = img->size;
+          while(end > 0 && img->buf[end-1] == 0xff)
+            end--;
+          if(end > dsize)
+            dsize = end;
+          for(int i = 0; i < dsize; i++)
+            if(!(mem->tags[i] & TAG_ALLOCATED))
+              mem->buf[i] = 0xff, mem->tags[i] |= TAG_ALLOCATED;
+        }
+      } else if(flags & UF_DEVIMAGE)
+        img = avr_devimage_load(pgm, p, mem);
+
+      // Spot check the image of what was last written before trusting it
+      if(img && !upd->basefile && (rc = avr_devimage_sample(pgm, p, mem, img, dsize)) <= 0) {
+        if(rc == 0)
+          pmsg_info("device image of %s%s is outdated, comparing with device\n", mem->desc, alias_mem_desc);
+        avr_free_mem(img);
+        img = NULL;
+      }
+      rc = avr_write_mem_diff(pgm, p, mem, dsize, img, &npages);
+      if (rc < 0) {
+        pmsg_error("unable to write %s%s memory, rc=%d\n", mem->desc, alias_mem_desc, rc);
+        if(flags & UF_DEVIMAGE)
+          avr_devimage_forget(pgm, p, mem);
+        avr_free_mem(img);
+        return LIBAVRDUDE_GENERAL_FAILURE;
+      }
+      pmsg_info("%d of %d page%s of %s%s unchanged and skipped, %d written and verified\n",
+        npages-rc, npages, str_plural(npages), mem->desc, alias_mem_desc, rc);
+      if(flags & UF_DEVIMAGE)   // Don't merge the assumptions of a reference image
+        avr_devimage_save(pgm, p, mem, upd->basefile? NULL: img);
+      avr_free_mem(img);
+      break;
+    }
+
+    if ((flags & (UF_NOWRITE | UF_DEVIMAGE)) == UF_DEVIMAGE)
+      avr_devimage_forget(pgm, p, mem); // Device contents are unknown until written and verified
+
+    if ((flags & (UF_NOWRITE | UF_VERIFY | UF_PAGEVERIFY)) == (UF_VERIFY | UF_PAGEVERIFY)) {
+      // Read back each page right after writing it, which replaces the verify pass
+      if(mem->size > 32 || verbose > 1)
+        report_progress(0, 1, "Writing");
+      rc = avr_write_verify_mem(pgm, p, mem, size, (flags & UF_AUTO_ERASE) != 0, fs.lastaddr+1);
+      report_progress(1, 1, NULL);
+      if (rc >= 0) {
+        int verified = fs.nbytes+fs.ntrailing;
+        pmsg_info("%d byte%s of %s%s written and verified page by page\n", verified,
+          str_plural(verified), mem->desc, alias_mem_desc);
+        if(flags & UF_DEVIMAGE)
+          avr_devimage_save(pgm, p, mem, NULL);
+        break;
+      }
+      if (rc != LIBAVRDUDE_NOTSUPPORTED) {
+        pmsg_error("unable to write %s%s memory, rc=%d\n", mem->desc, alias_mem_desc, rc);
+        return LIBAVRDUDE_GENERAL_FAILURE;
+      }
+      pmsg_notice2("cannot verify %s%s page by page, using separate verify pass\n",
+        mem->desc, alias_mem_desc);
+    }
+
     if (!(flags & UF_NOWRITE)) {
       if(mem->size > 32 || verbose > 1)
         report_progress(0, 1, "Writing");
@@ -508,7 +610,7 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
     pmsg_info("%d byte%s of %s%s written\n", fs.nbytes,
       str_plural(fs.nbytes), mem->desc, alias_mem_desc);
 
-    if (!(flags & UF_VERIFY))   // Fall through for auto verify unless
+    if (!(flags & UF_VERIFY))   // Fall through for auto verify unless -V; no device image then
       break;
     // Fall through
 
@@ -546,6 +648,31 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
       size = fs.lastaddr+1;
     }
 
+    // Programmers that can check a just written memory on the target only read back on mismatch
+    if(!userverify && pgm->crc_verify && pgm->crc_verify(pgm, p, mem) > 0) {
+      int verified = fs.nbytes+fs.ntrailing;
+      pmsg_info("%d byte%s of %s%s verified by on-target CRC\n", verified, str_plural(verified),
+        mem->desc, alias_mem_desc);
+      if ((flags & (UF_NOWRITE | UF_DEVIMAGE)) == UF_DEVIMAGE)
+        avr_devimage_save(pgm, p, mem, NULL);
+      led_clr(pgm, LED_VFY);
+      break;
+    }
+
+    // A device image that holds the file contents only needs confirming by a few pages
+    AVRMEM *img;
+    if(userverify && (flags & UF_DEVIMAGE) && (img = avr_devimage_load(pgm, p, mem))) {
+      int nsampled = avr_devimage_agrees(img, mem, 0, size)? avr_devimage_sample(pgm, p, mem, img, size): 0;
+      avr_free_mem(img);
+      if(nsampled > 0) {
+        int verified = fs.nbytes+fs.ntrailing;
+        pmsg_info("%d byte%s of %s%s verified against device image, %d page%s read back\n",
+          verified, str_plural(verified), mem->desc, alias_mem_desc, nsampled, str_plural(nsampled));
+        led_clr(pgm, LED_VFY);
+        break;
+      }
+    }
+
     v = avr_dup_part(p);
 
     if (quell_progress < 2) {
@@ -581,6 +708,8 @@ int do_op(const PROGRAMMER *pgm, const AVRPART *p, const UPDATE *upd, enum updat
 
     int verified = fs.nbytes+fs.ntrailing;
     pmsg_info("%d byte%s of %s%s verified\n", verified, str_plural(verified), mem->desc, alias_mem_desc);
+    if (!userverify && (flags & (UF_NOWRITE | UF_DEVIMAGE)) == UF_DEVIMAGE)
+      avr_devimage_save(pgm, p, mem, NULL);
 
     led_clr(pgm, LED_VFY);
     avr_free_part(v);
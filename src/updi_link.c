@@ -79,8 +79,36 @@ static int updi_physical_open(PROGRAMMER* pgm, int baudrate, unsigned long cflag
   return 0;
 }
 
+/*
+ * The UPDI line is a single wire, so every byte sent comes back as echo.
+ * Rather than waiting for the echo after each send, updi_physical_send()
+ * remembers the bytes and they are read back and compared in one go at the
+ * next receive or when the line state changes. This lets consecutive
+ * instructions stream back to back while still detecting line collisions.
+ */
+static int updi_physical_echo(const PROGRAMMER *pgm) {
+  updi_echo *echo = updi_get_echo(pgm);
+  unsigned char buf[UPDI_ECHO_BUFSIZE];
+  size_t len = echo->len;
+
+  if (len == 0) {
+    return 0;
+  }
+  echo->len = 0;
+  if (serial_recv(&pgm->fd, buf, len) < 0) {
+    pmsg_debug("echo of %lu sent bytes not received\n", (unsigned long) len);
+    return -1;
+  }
+  if (memcmp(buf, echo->buf, len)) {
+    pmsg_debug("echo differs from %lu sent bytes, collision on UPDI line?\n", (unsigned long) len);
+    return -1;
+  }
+  return 0;
+}
+
 static void updi_physical_close(PROGRAMMER* pgm)
 {
+  updi_physical_echo(pgm);
   serial_set_dtr_rts(&pgm->fd, 0);
   serial_close(&pgm->fd);
   pgm->fd.ifd = -1;
@@ -99,8 +127,21 @@ static int updi_physical_send(const PROGRAMMER *pgm, unsigned char *buf, size_t
   }
   msg_debug("]\n");
 
-  rv = serial_send(&pgm->fd, buf, len);
-  serial_recv(&pgm->fd, buf, len);
+  updi_echo *echo = updi_get_echo(pgm);
+  rv = 0;
+  while (len > 0) {
+    size_t chunk = len < UPDI_ECHO_BUFSIZE ? len : UPDI_ECHO_BUFSIZE;
+    if (echo->len + chunk > UPDI_ECHO_BUFSIZE && updi_physical_echo(pgm) < 0) {
+      return -1;
+    }
+    memcpy(echo->buf + echo->len, buf, chunk);
+    echo->len += chunk;
+    if ((rv = serial_send(&pgm->fd, buf, chunk)) < 0) {
+      return rv;
+    }
+    buf += chunk;
+    len -= chunk;
+  }
   return rv;
 }
 
@@ -108,6 +149,9 @@ static int updi_physical_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t
   size_t i;
   int rv;
 
+  if (updi_physical_echo(pgm) < 0) {
+    return -1;
+  }
   rv = serial_recv(&pgm->fd, buf, len);
   if (rv < 0) {
     pmsg_debug("serialupdi_recv(): programmer is not responding\n");
@@ -126,11 +170,20 @@ static int updi_physical_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t
   return len;
 }
 
+// Line rate in use: initial -b rate unless changed by updi_link_set_baud()
+static long updi_physical_baud(const PROGRAMMER *pgm) {
+  long baud = updi_get_link_baud(pgm);
+
+  return baud? baud: pgm->baudrate? pgm->baudrate: 115200;
+}
+
 static int updi_physical_send_double_break(const PROGRAMMER *pgm) {
   unsigned char buffer[1];
 
   pmsg_debug("sending double break\n");
 
+  updi_physical_echo(pgm);        // Let pending bytes go out at the old line settings
+
   if (serial_setparams(&pgm->fd, 300, SERIAL_8E1) < 0) {
     return -1;
   }
@@ -151,7 +204,7 @@ static int updi_physical_send_double_break(const PROGRAMMER *pgm) {
 
   serial_drain(&pgm->fd, 0);
 
-  if (serial_setparams(&pgm->fd, pgm->baudrate? pgm->baudrate: 115200, SERIAL_8E2) < 0) {
+  if (serial_setparams(&pgm->fd, updi_physical_baud(pgm), SERIAL_8E2) < 0) {
     return -1;
   }
 
@@ -296,6 +349,24 @@ int updi_link_init(const PROGRAMMER *pgm) {
   return 0;
 }
 
+/*
+ * Change the line rate of an established link and check that the target
+ * still answers; the UPDI picks up the new rate from the next SYNC character
+ */
+int updi_link_set_baud(const PROGRAMMER *pgm, long baud) {
+  pmsg_debug("changing line rate to %ld baud\n", baud);
+
+  updi_physical_echo(pgm);
+  if (serial_setparams(&pgm->fd, baud, SERIAL_8E2) < 0) {
+    return -1;
+  }
+  updi_set_rtsdtr_mode(pgm);
+  serial_drain(&pgm->fd, 0);
+  updi_set_link_baud(pgm, baud);
+
+  return updi_link_check(pgm);
+}
+
 int updi_link_ldcs(const PROGRAMMER *pgm, uint8_t address, uint8_t *value)  {
 /*
     def ldcs(self, address):
@@ -401,7 +472,7 @@ int updi_link_ld_ptr_inc16(const PROGRAMMER *pgm, unsigned char *buffer, uint16_
     pmsg_debug("LD_PTR_INC send operation failed\n");
     return -1;
   }
-  return updi_physical_recv(pgm, buffer, words << 2);
+  return updi_physical_recv(pgm, buffer, words << 1);
 }
 
 int updi_link_st_ptr_inc(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size) {
@@ -635,6 +706,94 @@ int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uin
   return 0;
 }
 
+/*
+ * Store size bytes to the pointer location with pointer post-increment with
+ * response signature disabled for all but the last byte. The first size-1
+ * bytes go out in a single burst; the last byte is stored with responses
+ * enabled again, so its ACK confirms that the whole burst was accepted.
+ */
+int updi_link_st_ptr_inc_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size) {
+  pmsg_debug("ST8 to *ptr++ with RSD, data length: 0x%03X\n", size);
+
+  if (size < 2 || size > UPDI_MAX_REPEAT_SIZE) {
+    pmsg_debug("invalid length %d\n", size);
+    return -1;
+  }
+
+  unsigned int temp_buffer_size = 3 + 3 + 2 + (size - 1) + 3 + 3;
+  unsigned char *temp_buffer = malloc(temp_buffer_size);
+  unsigned char recv_buffer[1];
+
+  if (temp_buffer == 0) {
+    pmsg_debug("allocating temporary buffer failed\n");
+    return -1;
+  }
+
+  temp_buffer[0] = UPDI_PHY_SYNC;
+  temp_buffer[1] = UPDI_STCS | UPDI_CS_CTRLA;
+  temp_buffer[2] = 0x0E;
+  temp_buffer[3] = UPDI_PHY_SYNC;
+  temp_buffer[4] = UPDI_REPEAT | UPDI_REPEAT_BYTE;
+  temp_buffer[5] = (size - 2) & 0xFF;
+  temp_buffer[6] = UPDI_PHY_SYNC;
+  temp_buffer[7] = UPDI_ST | UPDI_PTR_INC | UPDI_DATA_8;
+
+  memcpy(temp_buffer + 8, buffer, size - 1);
+
+  temp_buffer[temp_buffer_size-6] = UPDI_PHY_SYNC;
+  temp_buffer[temp_buffer_size-5] = UPDI_STCS | UPDI_CS_CTRLA;
+  temp_buffer[temp_buffer_size-4] = 0x06;
+  temp_buffer[temp_buffer_size-3] = UPDI_PHY_SYNC;
+  temp_buffer[temp_buffer_size-2] = UPDI_ST | UPDI_PTR_INC | UPDI_DATA_8;
+  temp_buffer[temp_buffer_size-1] = buffer[size - 1];
+
+  if (updi_physical_send(pgm, temp_buffer, temp_buffer_size) < 0) {
+    pmsg_debug("unable to send burst\n");
+    free(temp_buffer);
+    return -1;
+  }
+  free(temp_buffer);
+
+  if (updi_physical_recv(pgm, recv_buffer, 1) != 1 || recv_buffer[0] != UPDI_PHY_ACK) {
+    pmsg_debug("ACK was expected but not received after burst\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Set the pointer without waiting for its ACK: the ST ptr instruction is
+ * framed by STCS CTRLA with the response signature disable bit set and
+ * cleared, so nothing comes back and the following REPEAT/LD can be sent
+ * right away instead of after a round trip.
+ */
+int updi_link_st_ptr_RSD(const PROGRAMMER *pgm, uint32_t address) {
+  unsigned char send_buffer[11];
+  int n = 0;
+
+  pmsg_debug("ST_PTR to 0x%06X with RSD\n", address);
+  send_buffer[n++] = UPDI_PHY_SYNC;
+  send_buffer[n++] = UPDI_STCS | UPDI_CS_CTRLA;
+  send_buffer[n++] = 0x0E;
+  send_buffer[n++] = UPDI_PHY_SYNC;
+  send_buffer[n++] = UPDI_STS | UPDI_ST | UPDI_PTR_ADDRESS | (updi_get_datalink_mode(pgm) == UPDI_LINK_MODE_24BIT ? UPDI_DATA_24 : UPDI_DATA_16);
+  send_buffer[n++] = address & 0xFF;
+  send_buffer[n++] = (address >> 8) & 0xFF;
+  if (updi_get_datalink_mode(pgm) == UPDI_LINK_MODE_24BIT) {
+    send_buffer[n++] = (address >> 16) & 0xFF;
+  }
+  send_buffer[n++] = UPDI_PHY_SYNC;
+  send_buffer[n++] = UPDI_STCS | UPDI_CS_CTRLA;
+  send_buffer[n++] = 0x06;
+
+  if (updi_physical_send(pgm, send_buffer, n) < 0) {
+    pmsg_debug("ST_PTR with RSD send failed\n");
+    return -1;
+  }
+  return 0;
+}
+
 int updi_link_repeat(const PROGRAMMER *pgm, uint16_t repeats) {
 /*
     def repeat(self, repeats):
@@ -36,6 +36,7 @@ extern "C" {
 int updi_link_open(PROGRAMMER * pgm);
 void updi_link_close(PROGRAMMER * pgm);
 int updi_link_init(const PROGRAMMER *pgm);
+int updi_link_set_baud(const PROGRAMMER *pgm, long baud);
 int updi_link_ldcs(const PROGRAMMER *pgm, uint8_t address, uint8_t *value);
 int updi_link_stcs(const PROGRAMMER *pgm, uint8_t address, uint8_t value);
 int updi_link_ld_ptr_inc(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
@@ -43,6 +44,7 @@ int updi_link_ld_ptr_inc16(const PROGRAMMER *pgm, unsigned char *buffer, uint16_
 int updi_link_st_ptr_inc(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
 int updi_link_st_ptr_inc16(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t words);
 int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t words, int blocksize);
+int updi_link_st_ptr_inc_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
 int updi_link_repeat(const PROGRAMMER *pgm, uint16_t repeats);
 int updi_link_read_sib(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
 int updi_link_key(const PROGRAMMER *pgm, unsigned char *buffer, uint8_t size_type, uint16_t size);
@@ -51,6 +53,7 @@ int updi_link_ld16(const PROGRAMMER *pgm, uint32_t address, uint16_t *value);
 int updi_link_st(const PROGRAMMER *pgm, uint32_t address, uint8_t value);
 int updi_link_st16(const PROGRAMMER *pgm, uint32_t address, uint16_t value);
 int updi_link_st_ptr(const PROGRAMMER *pgm, uint32_t address);
+int updi_link_st_ptr_RSD(const PROGRAMMER *pgm, uint32_t address);
 
 #ifdef __cplusplus
 }
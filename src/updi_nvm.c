@@ -44,6 +44,9 @@
 #include "updi_state.h"
 
 int updi_nvm_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   switch(updi_get_nvm_mode(pgm))
   {
     case UPDI_NVM_MODE_V0:
@@ -63,6 +66,9 @@ int updi_nvm_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
 }
 
 int updi_nvm_erase_flash_page(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address) {
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   switch(updi_get_nvm_mode(pgm))
   {
     case UPDI_NVM_MODE_V0:
@@ -82,6 +88,9 @@ int updi_nvm_erase_flash_page(const PROGRAMMER *pgm, const AVRPART *p, uint32_t
 }
 
 int updi_nvm_erase_eeprom(const PROGRAMMER *pgm, const AVRPART *p) {
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   switch(updi_get_nvm_mode(pgm))
   {
     case UPDI_NVM_MODE_V0:
@@ -101,6 +110,9 @@ int updi_nvm_erase_eeprom(const PROGRAMMER *pgm, const AVRPART *p) {
 }
 
 int updi_nvm_erase_user_row(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address, uint16_t size) {
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   switch(updi_get_nvm_mode(pgm))
   {
     case UPDI_NVM_MODE_V0:
@@ -139,6 +151,9 @@ int updi_nvm_write_flash(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addre
 }
 
 int updi_nvm_write_user_row(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address, unsigned char *buffer, uint16_t size) {
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   switch(updi_get_nvm_mode(pgm))
   {
     case UPDI_NVM_MODE_V0:
@@ -158,6 +173,9 @@ int updi_nvm_write_user_row(const PROGRAMMER *pgm, const AVRPART *p, uint32_t ad
 }
 
 int updi_nvm_write_eeprom(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address, unsigned char *buffer, uint16_t size) {
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   switch(updi_get_nvm_mode(pgm))
   {
     case UPDI_NVM_MODE_V0:
@@ -177,6 +195,9 @@ int updi_nvm_write_eeprom(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addr
 }
 
 int updi_nvm_write_fuse(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address, uint8_t value) {
+  if (updi_nvm_flush(pgm, p) < 0) {
+    return -1;
+  }
   switch(updi_get_nvm_mode(pgm))
   {
     case UPDI_NVM_MODE_V0:
@@ -232,3 +253,103 @@ int updi_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command) {
       return -1;
   }
 }
+
+/*
+ * On NVM controllers v2 and v4 (AVR Dx) the flash write command stays active
+ * in NVMCTRL.CTRLA, so consecutive flash page writes leave it set and only
+ * stream data. Any other NVM operation, read or end of programming first
+ * waits for the last write to complete and clears the command here.
+ */
+int updi_nvm_flush(const PROGRAMMER *pgm, const AVRPART *p) {
+  int status;
+
+  if (!updi_get_nvm_command(pgm)) {
+    return 0;
+  }
+  updi_set_nvm_command(pgm, NULL, 0);
+  pmsg_debug("completing NVM command left active\n");
+  status = updi_nvm_wait_ready(pgm, p);
+  if (updi_nvm_command(pgm, p, 0) < 0) {
+    pmsg_error("clearing NVM command failed\n");
+    return -1;
+  }
+  if (status < 0) {
+    pmsg_error("updi_nvm_wait_ready() failed\n");
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * NVM busy timing: rather than reading the NVMCTRL status back to back while
+ * a page write or erase is in progress, updi_nvm_wait_ready_Vx() first sleeps
+ * for the time the pending command is expected to take and then polls with
+ * exponential back-off. The expected time starts out as the typical datasheet
+ * value of the NVM controller version and is then replaced by what was
+ * measured in this session: the midpoint between sending the last status
+ * read that showed busy and the one that showed ready. An operation that is found
+ * complete at the first poll may have finished earlier, so its estimate is
+ * lowered a little.
+ */
+
+#define UPDI_NVM_POLL_MIN_US    50
+#define UPDI_NVM_POLL_MAX_US 10000
+
+void updi_nvm_timing_start(const PROGRAMMER *pgm, uint8_t command, unsigned long typical_us) {
+  updi_nvm_timing *t = updi_get_nvm_timing(pgm);
+
+  if (t->busy_us[command] == 0) {
+    t->busy_us[command] = typical_us;
+  }
+  t->pending = 1;
+  t->command = command;
+  t->start = avr_ustimestamp();
+  t->polls = 0;
+}
+
+void updi_nvm_timing_sleep(const PROGRAMMER *pgm) {
+  updi_nvm_timing *t = updi_get_nvm_timing(pgm);
+
+  t->delay = UPDI_NVM_POLL_MIN_US;
+  if (!t->pending) {
+    return;
+  }
+  unsigned long expected = t->busy_us[t->command];
+  uint64_t elapsed = avr_ustimestamp() - t->start;
+  if (elapsed < expected) {
+    usleep(expected - elapsed);
+  }
+  if (expected/16 > t->delay) {
+    t->delay = expected/16;
+  }
+  t->poll = avr_ustimestamp();
+}
+
+void updi_nvm_timing_backoff(const PROGRAMMER *pgm) {
+  updi_nvm_timing *t = updi_get_nvm_timing(pgm);
+
+  t->polls++;
+  t->last_busy = t->poll;
+  usleep(t->delay);
+  t->delay = t->delay*2 > UPDI_NVM_POLL_MAX_US ? UPDI_NVM_POLL_MAX_US : t->delay*2;
+  t->poll = avr_ustimestamp();
+}
+
+void updi_nvm_timing_done(const PROGRAMMER *pgm) {
+  updi_nvm_timing *t = updi_get_nvm_timing(pgm);
+
+  if (!t->pending) {
+    return;
+  }
+  t->pending = 0;
+  unsigned long *busy = t->busy_us + t->command;
+  if (t->polls) {
+    *busy = (t->last_busy + t->poll)/2 - t->start;
+  } else {
+    *busy -= *busy/16;
+  }
+  if (*busy == 0) {             // Keep the measurement distinct from unknown
+    *busy = 1;
+  }
+  pmsg_debug("NVM command 0x%02x: %d busy polls, expect %lu us next time\n", t->command, t->polls, *busy);
+}
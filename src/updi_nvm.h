@@ -43,6 +43,11 @@ int updi_nvm_write_eeprom(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addr
 int updi_nvm_write_fuse(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address, uint8_t value);
 int updi_nvm_wait_ready(const PROGRAMMER *pgm, const AVRPART *p);
 int updi_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command);
+int updi_nvm_flush(const PROGRAMMER *pgm, const AVRPART *p);
+void updi_nvm_timing_start(const PROGRAMMER *pgm, uint8_t command, unsigned long typical_us);
+void updi_nvm_timing_sleep(const PROGRAMMER *pgm);
+void updi_nvm_timing_backoff(const PROGRAMMER *pgm);
+void updi_nvm_timing_done(const PROGRAMMER *pgm);
 
 #ifdef __cplusplus
 }
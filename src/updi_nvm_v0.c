@@ -35,6 +35,7 @@
 
 #include "avrdude.h"
 #include "libavrdude.h"
+#include "updi_nvm.h"
 #include "updi_nvm_v0.h"
 #include "updi_state.h"
 #include "updi_constants.h"
@@ -440,6 +441,26 @@ static int nvm_write_V0(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addres
   return 0;
 }
 
+// Typical busy time in us of an NVM command according to the tinyAVR 0/1/2 and megaAVR 0 datasheets
+static unsigned long typical_busy_us_V0(uint8_t command) {
+  switch (command) {
+    case UPDI_V0_NVMCTRL_CTRLA_WRITE_PAGE:
+      return 2000;
+    case UPDI_V0_NVMCTRL_CTRLA_ERASE_PAGE:
+      return 2000;
+    case UPDI_V0_NVMCTRL_CTRLA_ERASE_WRITE_PAGE:
+      return 4000;
+    case UPDI_V0_NVMCTRL_CTRLA_CHIP_ERASE:
+      return 4000;
+    case UPDI_V0_NVMCTRL_CTRLA_ERASE_EEPROM:
+      return 4000;
+    case UPDI_V0_NVMCTRL_CTRLA_WRITE_FUSE:
+      return 4000;
+    default:
+      return 0;
+  }
+}
+
 int updi_nvm_wait_ready_V0(const PROGRAMMER *pgm, const AVRPART *p) {
 /*
     def wait_nvm_ready(self):
@@ -465,6 +486,7 @@ int updi_nvm_wait_ready_V0(const PROGRAMMER *pgm, const AVRPART *p) {
   unsigned long start_time;
   unsigned long current_time;
   uint8_t status;
+  updi_nvm_timing_sleep(pgm);
   start_time = avr_ustimestamp();
   do {
     if (updi_read_byte(pgm, p->nvm_base + UPDI_V0_NVMCTRL_STATUS, &status) >= 0) {
@@ -474,9 +496,11 @@ int updi_nvm_wait_ready_V0(const PROGRAMMER *pgm, const AVRPART *p) {
       }
       if (!(status & ((1 << UPDI_V0_NVM_STATUS_EEPROM_BUSY_BIT) | 
                       (1 << UPDI_V0_NVM_STATUS_FLASH_BUSY_BIT)))) {
+        updi_nvm_timing_done(pgm);
         return 0;
       }
     }
+    updi_nvm_timing_backoff(pgm);
     current_time = avr_ustimestamp();
   } while ((current_time - start_time) < 10000000);
 
@@ -497,5 +521,9 @@ int updi_nvm_command_V0(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command
 */
   pmsg_debug("NVMCMD %d executing\n", command);
 
-  return updi_write_byte(pgm, p->nvm_base + UPDI_V0_NVMCTRL_CTRLA, command);
+  if (updi_write_byte(pgm, p->nvm_base + UPDI_V0_NVMCTRL_CTRLA, command) < 0) {
+    return -1;
+  }
+  updi_nvm_timing_start(pgm, command, typical_busy_us_V0(command));
+  return 0;
 }
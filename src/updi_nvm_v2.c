@@ -35,6 +35,7 @@
 
 #include "avrdude.h"
 #include "libavrdude.h"
+#include "updi_nvm.h"
 #include "updi_nvm_v2.h"
 #include "updi_state.h"
 #include "updi_constants.h"
@@ -325,7 +326,7 @@ int updi_nvm_write_eeprom_V2(const PROGRAMMER *pgm, const AVRPART *p, uint32_t a
     pmsg_error("EEPROM erase command failed\n");
     return -1;
   }
-  if (updi_write_data(pgm, address, buffer, size) < 0) {
+  if (updi_write_data_acked(pgm, address, buffer, size) < 0) {
     pmsg_error("write data operation failed\n");
     return -1;
   }
@@ -404,14 +405,21 @@ static int nvm_write_V2(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addres
             raise PymcuprogSerialUpdiNvmTimeout("Timeout waiting for NVM controller to be ready after data write")
 */
   int status;
-  if (updi_nvm_wait_ready_V2(pgm, p) < 0) {
-    pmsg_error("updi_nvm_wait_ready_V2() failed\n");
-    return -1;
-  }
-  pmsg_debug("NVM write command\n");
-  if (updi_nvm_command_V2(pgm, p, UPDI_V2_NVMCTRL_CTRLA_FLASH_WRITE) < 0) {
-    pmsg_error("clear page operation failed\n");
-    return -1;
+  if (mode == USE_WORD_ACCESS && updi_get_nvm_command(pgm) == UPDI_V2_NVMCTRL_CTRLA_FLASH_WRITE) {
+    pmsg_debug("NVM write command still active\n");
+  } else {
+    if (updi_nvm_wait_ready_V2(pgm, p) < 0) {
+      pmsg_error("updi_nvm_wait_ready_V2() failed\n");
+      return -1;
+    }
+    pmsg_debug("NVM write command\n");
+    if (updi_nvm_command_V2(pgm, p, UPDI_V2_NVMCTRL_CTRLA_FLASH_WRITE) < 0) {
+      pmsg_error("clear page operation failed\n");
+      return -1;
+    }
+    if (mode == USE_WORD_ACCESS) {
+      updi_set_nvm_command(pgm, p, UPDI_V2_NVMCTRL_CTRLA_FLASH_WRITE);
+    }
   }
   if (mode == USE_WORD_ACCESS) {
     if (updi_write_data_words(pgm, address, buffer, size) < 0) {
@@ -424,6 +432,9 @@ static int nvm_write_V2(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addres
       return -1;
     }
   }
+  if (mode == USE_WORD_ACCESS) {
+    return 0;                   // Completed by updi_nvm_flush()
+  }
   status = updi_nvm_wait_ready_V2(pgm, p); 
   pmsg_debug("clear NVM command\n");
   if (updi_nvm_command_V2(pgm, p, UPDI_V2_NVMCTRL_CTRLA_NOCMD) < 0) {
@@ -437,6 +448,26 @@ static int nvm_write_V2(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addres
   return 0;
 }
 
+// Typical busy time in us of an NVM command according to the AVR Dx datasheets
+static unsigned long typical_busy_us_V2(uint8_t command) {
+  switch (command) {
+    case UPDI_V2_NVMCTRL_CTRLA_FLASH_PAGE_ERASE:
+      return 10000;
+    case UPDI_V2_NVMCTRL_CTRLA_EEPROM_ERASE_WRITE:
+      return 11000;
+    case UPDI_V2_NVMCTRL_CTRLA_EEPROM_WRITE:
+      return 11000;
+    case UPDI_V2_NVMCTRL_CTRLA_EEPROM_BYTE_ERASE:
+      return 11000;
+    case UPDI_V2_NVMCTRL_CTRLA_CHIP_ERASE:
+      return 10000;
+    case UPDI_V2_NVMCTRL_CTRLA_EEPROM_ERASE:
+      return 10000;
+    default:
+      return 0;
+  }
+}
+
 int updi_nvm_wait_ready_V2(const PROGRAMMER *pgm, const AVRPART *p) {
 /*
     def wait_nvm_ready(self, timeout_ms=100):
@@ -467,6 +498,7 @@ int updi_nvm_wait_ready_V2(const PROGRAMMER *pgm, const AVRPART *p) {
   unsigned long start_time;
   unsigned long current_time;
   uint8_t status;
+  updi_nvm_timing_sleep(pgm);
   start_time = avr_ustimestamp();
   do {
     if (updi_read_byte(pgm, p->nvm_base + UPDI_V2_NVMCTRL_STATUS, &status) >= 0) {
@@ -476,9 +508,11 @@ int updi_nvm_wait_ready_V2(const PROGRAMMER *pgm, const AVRPART *p) {
       }
       if (!(status & ((1 << UPDI_V2_NVM_STATUS_EEPROM_BUSY_BIT) | 
                       (1 << UPDI_V2_NVM_STATUS_FLASH_BUSY_BIT)))) {
+        updi_nvm_timing_done(pgm);
         return 0;
       }
     }
+    updi_nvm_timing_backoff(pgm);
     current_time = avr_ustimestamp();
   } while ((current_time - start_time) < 10000000);
 
@@ -499,5 +533,9 @@ int updi_nvm_command_V2(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command
 */
   pmsg_debug("NVMCMD %d executing\n", command);
 
-  return updi_write_byte(pgm, p->nvm_base + UPDI_V2_NVMCTRL_CTRLA, command);
+  if (updi_write_byte(pgm, p->nvm_base + UPDI_V2_NVMCTRL_CTRLA, command) < 0) {
+    return -1;
+  }
+  updi_nvm_timing_start(pgm, command, typical_busy_us_V2(command));
+  return 0;
 }
@@ -167,6 +167,48 @@ int updi_read_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uin
   return updi_link_ld_ptr_inc(pgm, buffer, size);
 }
 
+/*
+ * Read a larger area in REPEAT blocks of up to blocksize bytes. The pointer
+ * is set once, without an ACK, and then post-increments from one block to
+ * the next, so each block costs a single REPEAT + LD *ptr++ exchange.
+ */
+int updi_read_data_blocks(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint32_t size, uint16_t blocksize) {
+  uint32_t done = 0;
+
+  pmsg_debug("reading %u bytes from 0x%06X in blocks of %d\n", (unsigned) size, address, blocksize);
+
+  if (blocksize < 1 || blocksize > UPDI_MAX_REPEAT_SIZE) {
+    blocksize = UPDI_MAX_REPEAT_SIZE;
+  }
+
+  if (size == 0) {
+    return 0;
+  }
+
+  if (updi_link_st_ptr_RSD(pgm, address) < 0) {
+    pmsg_debug("ST_PTR operation failed\n");
+    return -1;
+  }
+
+  while (done < size) {
+    uint16_t n = size - done > blocksize ? blocksize : size - done;
+
+    if (n > 1) {
+      if (updi_link_repeat(pgm, n) < 0) {
+        pmsg_debug("repeat operation failed\n");
+        return -1;
+      }
+    }
+    if (updi_link_ld_ptr_inc(pgm, buffer + done, n) < 0) {
+      pmsg_debug("LD_PTR_INC operation failed at 0x%06X\n", (unsigned) (address + done));
+      return -1;
+    }
+    done += n;
+  }
+
+  return done;
+}
+
 int updi_write_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size) {
 /*
     def write_data(self, address, data):
@@ -213,6 +255,26 @@ int updi_write_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, ui
     pmsg_debug("ST_PTR operation failed\n");
     return -1;
   }
+  return updi_link_st_ptr_inc_RSD(pgm, buffer, size);
+}
+
+/*
+ * As updi_write_data() but every byte waits for its ACK; needed where each
+ * store starts a self-timed NVM operation that halts the bus, eg, byte-wise
+ * EEPROM erase/write of NVM controller versions 2 and 4
+ */
+int updi_write_data_acked(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size) {
+  if (size <= 2) {
+    return updi_write_data(pgm, address, buffer, size);
+  }
+  if (size > UPDI_MAX_REPEAT_SIZE) {
+    pmsg_debug("invalid length\n");
+    return -1;
+  }
+  if (updi_link_st_ptr(pgm, address) < 0) {
+    pmsg_debug("ST_PTR operation failed\n");
+    return -1;
+  }
   if (updi_link_repeat(pgm, size) < 0) {
     pmsg_debug("repeat operation failed\n");
     return -1;
@@ -266,6 +328,56 @@ int updi_read_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffe
   return updi_link_ld_ptr_inc16(pgm, buffer, size);
 }
 
+/*
+ * Word-wise counterpart of updi_read_data_blocks(): LD16 *ptr++ lets one
+ * REPEAT cover up to 256 words, twice as many bytes per exchange. An odd
+ * trailing byte is read with a final 8-bit LD *ptr++.
+ */
+int updi_read_data_words_blocks(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint32_t size, uint16_t blockwords) {
+  uint32_t done = 0, words = size >> 1;
+
+  pmsg_debug("reading %u bytes from 0x%06X in blocks of %d words\n", (unsigned) size, address, blockwords);
+
+  if (blockwords < 1 || blockwords > UPDI_MAX_REPEAT_SIZE) {
+    blockwords = UPDI_MAX_REPEAT_SIZE;
+  }
+
+  if (size == 0) {
+    return 0;
+  }
+
+  if (updi_link_st_ptr_RSD(pgm, address) < 0) {
+    pmsg_debug("ST_PTR operation failed\n");
+    return -1;
+  }
+
+  while (done < words << 1) {
+    uint16_t n = words - (done >> 1) > blockwords ? blockwords : words - (done >> 1);
+
+    if (n > 1) {
+      if (updi_link_repeat(pgm, n) < 0) {
+        pmsg_debug("repeat operation failed\n");
+        return -1;
+      }
+    }
+    if (updi_link_ld_ptr_inc16(pgm, buffer + done, n) < 0) {
+      pmsg_debug("LD16_PTR_INC operation failed at 0x%06X\n", (unsigned) (address + done));
+      return -1;
+    }
+    done += n << 1;
+  }
+
+  if (size & 1) {
+    if (updi_link_ld_ptr_inc(pgm, buffer + done, 1) < 0) {
+      pmsg_debug("LD_PTR_INC operation failed at 0x%06X\n", (unsigned) (address + done));
+      return -1;
+    }
+    done++;
+  }
+
+  return done;
+}
+
 int updi_write_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size) {
 /*
     def write_data_words(self, address, data):
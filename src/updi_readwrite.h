@@ -40,8 +40,11 @@ int updi_read_sib(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
 int updi_read_byte(const PROGRAMMER *pgm, uint32_t address, uint8_t *value);
 int updi_write_byte(const PROGRAMMER *pgm, uint32_t address, uint8_t value);
 int updi_read_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size);
+int updi_read_data_blocks(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint32_t size, uint16_t blocksize);
 int updi_write_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size);
+int updi_write_data_acked(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size);
 int updi_read_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size);
+int updi_read_data_words_blocks(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint32_t size, uint16_t blockwords);
 int updi_write_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size);
 
 #ifdef __cplusplus
@@ -33,6 +33,14 @@ updi_sib_info* updi_get_sib_info(const PROGRAMMER *pgm) {
   return &((updi_state *)(pgm->cookie))->sib_info;
 }
 
+updi_echo* updi_get_echo(const PROGRAMMER *pgm) {
+  return &((updi_state *)(pgm->cookie))->echo;
+}
+
+updi_nvm_timing* updi_get_nvm_timing(const PROGRAMMER *pgm) {
+  return &((updi_state *)(pgm->cookie))->nvm_timing;
+}
+
 updi_datalink_mode updi_get_datalink_mode(const PROGRAMMER *pgm) {
   return ((updi_state *)(pgm->cookie))->datalink_mode;
 }
@@ -56,3 +64,59 @@ updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm) {
 void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode) {
   ((updi_state *)(pgm->cookie))->rts_mode = mode;
 }
+
+long updi_get_link_baud(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->link_baud;
+}
+
+void updi_set_link_baud(const PROGRAMMER *pgm, long baud) {
+  ((updi_state *)(pgm->cookie))->link_baud = baud;
+}
+
+long updi_get_fast_baud(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->fast_baud;
+}
+
+void updi_set_fast_baud(const PROGRAMMER *pgm, long baud) {
+  ((updi_state *)(pgm->cookie))->fast_baud = baud;
+}
+
+uint8_t updi_get_nvm_command(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->nvm_command;
+}
+
+void updi_set_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command) {
+  ((updi_state *)(pgm->cookie))->nvm_command = command;
+  ((updi_state *)(pgm->cookie))->nvm_part = p;
+}
+
+const AVRPART *updi_get_nvm_part(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->nvm_part;
+}
+
+int updi_get_flash_erased(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->flash_erased;
+}
+
+void updi_set_flash_erased(const PROGRAMMER *pgm, int erased) {
+  ((updi_state *)(pgm->cookie))->flash_erased = erased;
+  ((updi_state *)(pgm->cookie))->flash_end = 0;
+}
+
+// Flash is no longer known to be blank outside what was written once a write revisits written flash
+void updi_flash_written(const PROGRAMMER *pgm, uint32_t addr, uint32_t n_bytes) {
+  updi_state *us = (updi_state *)(pgm->cookie);
+
+  if (addr < us->flash_end)
+    us->flash_erased = 0;
+  else
+    us->flash_end = addr + n_bytes;
+}
+
+int updi_get_crc_verify(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->crc_verify;
+}
+
+void updi_set_crc_verify(const PROGRAMMER *pgm, int crc_verify) {
+  ((updi_state *)(pgm->cookie))->crc_verify = crc_verify;
+}
@@ -70,9 +70,38 @@ typedef enum
   RTS_MODE_HIGH
 } updi_rts_mode;
 
+#define UPDI_ECHO_BUFSIZE 512
+
+typedef struct
+{
+  unsigned char buf[UPDI_ECHO_BUFSIZE];  // Bytes sent whose echo has not been read back yet
+  size_t len;
+} updi_echo;
+
+typedef struct
+{
+  int pending;                  // An NVM command was issued and its completion not yet seen
+  uint8_t command;
+  uint64_t start;               // Time stamp in us when the command was issued
+  uint64_t poll;                // Time stamp at which the current status read was sent
+  uint64_t last_busy;           // Time stamp at which the last status read showing busy was sent
+  unsigned long delay;          // Current back-off between status polls in us
+  int polls;                    // Busy status reads for the pending command
+  unsigned long busy_us[256];   // Busy time per command measured in this session, 0: unknown
+} updi_nvm_timing;
+
 typedef struct
 {
   updi_sib_info sib_info;
+  updi_echo echo;
+  updi_nvm_timing nvm_timing;
+  long link_baud;               // Line rate after a baud rate change, 0: initial rate
+  long fast_baud;               // Line rate to switch to after reading the SIB, 0: none
+  uint8_t nvm_command;          // Flash write command left active in NVMCTRL.CTRLA, 0: none
+  const AVRPART *nvm_part;      // Part for which nvm_command is active
+  int flash_erased;             // Flash is blank after a chip erase apart from pages below flash_end
+  uint32_t flash_end;           // End of the flash written in ascending order since the chip erase
+  int crc_verify;               // Verify flash with the CRCSCAN peripheral (-xcrcverify)
   updi_datalink_mode datalink_mode;
   updi_nvm_mode nvm_mode;
   updi_rts_mode rts_mode;
@@ -83,12 +112,26 @@ extern "C" {
 #endif
 
 updi_sib_info* updi_get_sib_info(const PROGRAMMER *pgm);
+updi_echo* updi_get_echo(const PROGRAMMER *pgm);
+updi_nvm_timing* updi_get_nvm_timing(const PROGRAMMER *pgm);
 updi_datalink_mode updi_get_datalink_mode(const PROGRAMMER *pgm);
 void updi_set_datalink_mode(const PROGRAMMER *pgm, updi_datalink_mode mode);
 updi_nvm_mode updi_get_nvm_mode(const PROGRAMMER *pgm);
 void updi_set_nvm_mode(const PROGRAMMER *pgm, updi_nvm_mode mode);
 updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm);
 void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode);
+long updi_get_link_baud(const PROGRAMMER *pgm);
+void updi_set_link_baud(const PROGRAMMER *pgm, long baud);
+long updi_get_fast_baud(const PROGRAMMER *pgm);
+void updi_set_fast_baud(const PROGRAMMER *pgm, long baud);
+uint8_t updi_get_nvm_command(const PROGRAMMER *pgm);
+void updi_set_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command);
+const AVRPART *updi_get_nvm_part(const PROGRAMMER *pgm);
+int updi_get_flash_erased(const PROGRAMMER *pgm);
+void updi_set_flash_erased(const PROGRAMMER *pgm, int erased);
+void updi_flash_written(const PROGRAMMER *pgm, uint32_t addr, uint32_t n_bytes);
+int updi_get_crc_verify(const PROGRAMMER *pgm);
+void updi_set_crc_verify(const PROGRAMMER *pgm, int crc_verify);
 
 #ifdef __cplusplus
 }
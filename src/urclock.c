@@ -1894,7 +1894,7 @@ static int readUrclockID(const PROGRAMMER *pgm, const AVRPART *p, uint64_t *urcl
   // Urclock ID
   for(int i = len-1; i >= 0; i--)
     *urclockIDp <<= 8, *urclockIDp |= spc[i];
-  ur.idlen = len;
+  ur.idmchr = mchr, ur.idaddr = addr, ur.idlen = len; // Same location on next call
 
   return 0;
 }
@@ -2405,6 +2405,20 @@ static void urclock_display(const PROGRAMMER *pgm, const char *p_unused) {
 // End of STK500 section
 
 
+// Urclock ID as device id for the host-side device image cache; erased or zero IDs don't count
+static int urclock_device_id(const PROGRAMMER *pgm, const AVRPART *p, char *id, size_t n) {
+  uint64_t urclockID;
+
+  if(readUrclockID(pgm, p, &urclockID) < 0 || (size_t) 2*ur.idlen >= n)
+    return -1;
+  if(urclockID == 0 || urclockID == (ur.idlen >= 8? ~(uint64_t) 0: ((uint64_t) 1 << 8*ur.idlen) - 1))
+    return -1;
+  sprintf(id, "%0*llx", 2*ur.idlen, (unsigned long long) urclockID);
+
+  return 0;
+}
+
+
 // Return whether an address is write protected
 static int urclock_readonly(const struct programmer_t *pgm, const AVRPART *p_unused,
   const AVRMEM *mem, unsigned int addr) {
@@ -2468,6 +2482,7 @@ static int urclock_parseextparms(const PROGRAMMER *pgm, LISTID extparms) {
     {"nometadata", &ur.nometadata, NA,    "Do not support metadata at all"},
     {"delay", &ur.delay, ARG,             "Add delay [ms] after reset, can be negative"},
     {"strict", &ur.strict, NA,            "Use strict synchronisation protocol"},
+    {"lowlatency", &serial_low_latency, NA, "Set USB-serial adapter latency timer to 1 ms"},
     {"help", &help, NA,                   "Show this help menu and exit"},
   };
 
@@ -2558,6 +2573,7 @@ const char urclock_desc[] = "Urclock programmer for urboot bootloaders (arduino
 
 void urclock_initpgm(PROGRAMMER *pgm) {
   strcpy(pgm->type, "Urclock");
+  pgm->paged_max = 65535;       // Paged r/w loop over pages, so can do several
 
   pgm->read_sig_bytes = urclock_read_sig_bytes;
 
@@ -2583,6 +2599,7 @@ void urclock_initpgm(PROGRAMMER *pgm) {
   pgm->term_keep_alive = urclock_term_keep_alive;
   pgm->readonly = urclock_readonly;
   pgm->flash_readhook = urclock_flash_readhook;
+  pgm->device_id = urclock_device_id;
 
   disable_trailing_ff_removal();
 #if defined(HAVE_LIBREADLINE)
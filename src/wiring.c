@@ -106,10 +106,14 @@ static int wiring_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
       pmsg_notice2("%s(): delay set to %d ms\n", __func__, val);
       WIRINGPDATA(pgm)->delay = val;
       continue;
+    } else if (str_eq(extended_param, "lowlatency")) {
+      serial_low_latency = 1;
+      continue;
     } else if (str_eq(extended_param, "help")) {
       msg_error("%s -c %s extended options:\n", progname, pgmid);
       msg_error("  -xsnooze=<arg> Wait snooze [ms] before protocol sync after port open\n");
       msg_error("  -xdelay=<arg>  Add delay [ms] after reset, can be negative\n");
+      msg_error("  -xlowlatency   Set USB-serial adapter latency timer to 1 ms\n");
       msg_error("  -xhelp         Show this help menu and exit\n");
       return LIBAVRDUDE_EXIT;;
     }
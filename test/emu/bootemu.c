@@ -0,0 +1,568 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2024 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bootloader emulator on a pseudo terminal for benchmarking serial
+ * programmers without a board:
+ *
+ *  - stk500v1: optiboot, use with avrdude -c arduino
+ *  - stk500v2: stk500boot as used by Arduino Mega, use with avrdude -c wiring
+ *  - urclock:  urboot with urprotocol, use with avrdude -c urclock
+ *
+ * Example:
+ *
+ *   bootemu -c urclock -p m328p -l /tmp/ttyEMU &
+ *   avrdude -c urclock -p m328p -P /tmp/ttyEMU -U flash:w:blink.hex
+ *
+ * Each time avrdude leaves programming mode the emulator prints the session
+ * statistics, ie, elapsed time, bytes on the line and NVM pages written/read.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "emu.h"
+#include "stk500_private.h"
+
+// STK500v2 constants from stk500v2_private.h, which needs libavrdude.h
+#define MESSAGE_START               0x1B
+#define TOKEN                       0x0E
+
+#define CMD_SIGN_ON                 0x01
+#define CMD_SET_PARAMETER           0x02
+#define CMD_GET_PARAMETER           0x03
+#define CMD_SET_DEVICE_PARAMETERS   0x04
+#define CMD_OSCCAL                  0x05
+#define CMD_LOAD_ADDRESS            0x06
+#define CMD_ENTER_PROGMODE_ISP      0x10
+#define CMD_LEAVE_PROGMODE_ISP      0x11
+#define CMD_CHIP_ERASE_ISP          0x12
+#define CMD_PROGRAM_FLASH_ISP       0x13
+#define CMD_READ_FLASH_ISP          0x14
+#define CMD_PROGRAM_EEPROM_ISP      0x15
+#define CMD_READ_EEPROM_ISP         0x16
+#define CMD_PROGRAM_FUSE_ISP        0x17
+#define CMD_READ_FUSE_ISP           0x18
+#define CMD_PROGRAM_LOCK_ISP        0x19
+#define CMD_READ_LOCK_ISP           0x1A
+#define CMD_READ_SIGNATURE_ISP      0x1B
+#define CMD_SPI_MULTI               0x1D
+
+#define STATUS_CMD_OK               0x00
+#define STATUS_CMD_FAILED           0xC0
+#define STATUS_CKSUM_ERROR          0xC1
+#define STATUS_CMD_UNKNOWN          0xC9
+#define ANSWER_CKSUM_ERROR          0xB0
+
+#define PARAM_HW_VER                0x90
+#define PARAM_SW_MAJOR              0x91
+#define PARAM_SW_MINOR              0x92
+
+// Urboot feature bits and bootinfo encoding from urclock_private.h
+#define UB_N_MCU             2040
+#define UB_READ_FLASH           4
+#define UB_CHIP_ERASE          16
+#define UB_INFO(ub_features, ub_mcuid) ((ub_features)*UB_N_MCU + (ub_mcuid))
+
+#define Cmnd_UR_PROG_PAGE_EE 0x00
+#define Cmnd_UR_READ_PAGE_EE 0x01
+#define Cmnd_UR_PROG_PAGE_FL 0x02
+#define Cmnd_UR_READ_PAGE_FL 0x03
+
+#define TIMEOUT_MS 500          // Abandon partially received command after this time
+
+typedef enum { P_STK500V1, P_STK500V2, P_URCLOCK } Protocol;
+
+static struct {
+  uint32_t addr;                // Word address (stk500v1, stk500v2)
+  uint8_t ext;                  // Extended address byte (stk500v1)
+  uint8_t insync, ok;           // Response bytes: urprotocol encodes MCU id and features here
+  uint32_t blstart;             // Start of emulated bootloader
+} bl;
+
+static void on_signal(int sig) {
+  (void) sig;
+  emu_quit = 1;
+}
+
+// Put version info of the emulated bootloader at the top of flash
+static void init_bootloader(Emu *e, Protocol proto) {
+  const Emu_part *p = e->part;
+  uint8_t *top = e->flash + p->flashsize - 6;
+
+  bl.blstart = p->flashsize - p->bootsize;
+  bl.insync = Resp_STK_INSYNC;
+  bl.ok = Resp_STK_OK;
+  memset(e->flash + bl.blstart, 0, p->bootsize - 6);
+
+  switch(proto) {
+  case P_STK500V1:              // Optiboot v8.0: minor and major version in top flash word
+    top[4] = 0;
+    top[5] = 8;
+    break;
+  case P_URCLOCK: {             // Urboot v7.7 with ret opcode instead of pgm_write_page()
+    int info = UB_INFO(UB_READ_FLASH | UB_CHIP_ERASE, p->mcuid);
+    top[0] = p->bootsize/p->pagesize;
+    top[1] = 0;                 // Not a vector bootloader
+    top[2] = 0x08;              // ret
+    top[3] = 0x95;
+    top[4] = 0x80 | 0x40 | 0x20 | 0x02 | 0x01; // Autobaud, EEPROM, urprotocol, protect, CE
+    top[5] = 077;
+    // Inverse of the decoding in urclock_getsync()
+    bl.insync = info/255;
+    bl.ok = info%255;
+    if(bl.ok >= bl.insync)
+      bl.ok++;
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+// Receive EOP that concludes a STK500v1 command; optiboot resets on anything else
+static int eop(Emu *e) {
+  int c = emu_getc(e, TIMEOUT_MS);
+
+  if(c == Sync_CRC_EOP)
+    return 0;
+  if(c >= 0)
+    emu_log(e, "expected EOP but got 0x%02x\n", c);
+
+  return -1;
+}
+
+static int reply(Emu *e, const uint8_t *data, int n) {
+  uint8_t buf[1024+2];
+
+  buf[0] = bl.insync;
+  if(n)
+    memcpy(buf+1, data, n);
+  buf[n+1] = bl.ok;
+
+  return emu_send(e, buf, n+2);
+}
+
+static void write_mem(Emu *e, char memchr, uint32_t addr, const uint8_t *data, int len) {
+  if(memchr == 'E') {
+    emu_write_eeprom(e, addr, data, len);
+  } else if(addr < bl.blstart) { // Bootloaders protect themselves
+    if(addr + len > bl.blstart)
+      len = bl.blstart - addr;
+    emu_write_flash(e, addr, data, len);
+  }
+}
+
+static void read_mem(Emu *e, char memchr, uint32_t addr, uint8_t *data, int len) {
+  if(memchr == 'E')
+    emu_read_eeprom(e, addr, data, len);
+  else
+    emu_read_flash(e, addr, data, len);
+}
+
+// One STK500v1 command as understood by optiboot, or by urboot if urprotocol is set
+static int stk500v1_cmd(Emu *e, int urprotocol) {
+  uint8_t buf[1024+8];
+  int c, len;
+
+  if((c = emu_getc(e, -1)) < 0)
+    return c;
+
+  e->sess.ncmds++;
+
+  if(urprotocol && c <= Cmnd_UR_READ_PAGE_FL) { // Urprotocol paged access
+    const Emu_part *p = e->part;
+    int n = p->flashsize > 0x10000? 3: 2;
+    uint32_t addr;
+
+    n += p->pagesize > 256? 2: 1;
+    if(emu_getn(e, buf, n, TIMEOUT_MS) < 0)
+      return 0;
+    addr = buf[0] | buf[1]<<8 | (p->flashsize > 0x10000? buf[2]<<16: 0);
+    len = p->pagesize > 256? buf[n-2]<<8 | buf[n-1]: buf[n-1]? buf[n-1]: 256;
+    char memchr = c == Cmnd_UR_PROG_PAGE_EE || c == Cmnd_UR_READ_PAGE_EE? 'E': 'F';
+
+    if(c == Cmnd_UR_PROG_PAGE_EE || c == Cmnd_UR_PROG_PAGE_FL) {
+      if(len > 1024 || emu_getn(e, buf, len, TIMEOUT_MS) < 0 || eop(e) < 0)
+        return 0;
+      emu_log(e, "ur write %c 0x%05x len %d\n", memchr, addr, len);
+      write_mem(e, memchr, addr, buf, len);
+      return reply(e, NULL, 0);
+    }
+    if(len > 1024 || eop(e) < 0)
+      return 0;
+    emu_log(e, "ur read %c 0x%05x len %d\n", memchr, addr, len);
+    read_mem(e, memchr, addr, buf, len);
+    return reply(e, buf, len);
+  }
+
+  switch(c) {
+  case Cmnd_STK_GET_PARAMETER:
+    if((c = emu_getc(e, TIMEOUT_MS)) < 0 || eop(e) < 0)
+      return 0;
+    buf[0] = c == Parm_STK_SW_MAJOR? 8: c == Parm_STK_SW_MINOR? 0: 3;
+    return reply(e, buf, 1);
+
+  case Cmnd_STK_SET_DEVICE:
+  case Cmnd_STK_SET_DEVICE_EXT:
+    if(emu_getn(e, buf, c == Cmnd_STK_SET_DEVICE? 20: 5, TIMEOUT_MS) < 0 || eop(e) < 0)
+      return 0;
+    return reply(e, NULL, 0);
+
+  case Cmnd_STK_LOAD_ADDRESS:
+    if(emu_getn(e, buf, 2, TIMEOUT_MS) < 0 || eop(e) < 0)
+      return 0;
+    bl.addr = buf[0] | buf[1]<<8 | bl.ext<<16;
+    emu_log(e, "load address 0x%05x\n", bl.addr);
+    return reply(e, NULL, 0);
+
+  case Cmnd_STK_UNIVERSAL:
+    if(emu_getn(e, buf, 4, TIMEOUT_MS) < 0 || eop(e) < 0)
+      return 0;
+    if(buf[0] == 0x4d)          // Load extended address
+      bl.ext = buf[2];
+    buf[0] = 0;
+    return reply(e, buf, 1);
+
+  case Cmnd_STK_PROG_PAGE:
+  case Cmnd_STK_READ_PAGE: {
+    char memchr;
+    if(emu_getn(e, buf, 3, TIMEOUT_MS) < 0)
+      return 0;
+    len = buf[0]<<8 | buf[1];
+    memchr = buf[2];
+    if(len > 1024)
+      return 0;
+    if(c == Cmnd_STK_PROG_PAGE) {
+      if(emu_getn(e, buf, len, TIMEOUT_MS) < 0 || eop(e) < 0)
+        return 0;
+      emu_log(e, "write %c 0x%05x len %d\n", memchr, bl.addr*2, len);
+      write_mem(e, memchr, bl.addr*2, buf, len);
+      return reply(e, NULL, 0);
+    }
+    if(eop(e) < 0)
+      return 0;
+    emu_log(e, "read %c 0x%05x len %d\n", memchr, bl.addr*2, len);
+    read_mem(e, memchr, bl.addr*2, buf, len);
+    return reply(e, buf, len);
+  }
+
+  case Cmnd_STK_READ_SIGN:
+    if(eop(e) < 0)
+      return 0;
+    return reply(e, e->part->sig, 3);
+
+  case Cmnd_STK_CHIP_ERASE:
+    if(eop(e) < 0)
+      return 0;
+    if(urprotocol) {
+      emu_log(e, "chip erase\n");
+      emu_erase_flash(e, 0, bl.blstart);
+    }
+    return reply(e, NULL, 0);
+
+  case Cmnd_STK_LEAVE_PROGMODE:
+    if(eop(e) < 0)
+      return 0;
+    reply(e, NULL, 0);
+    bl.ext = 0;
+    emu_session_end(e);
+    return 0;
+
+  default:                      // Get sync, enter progmode and all else: just acknowledge
+    if(eop(e) < 0)
+      return 0;
+    return reply(e, NULL, 0);
+  }
+}
+
+static int stk500v2_reply(Emu *e, uint8_t seq, const uint8_t *body, int n) {
+  uint8_t buf[1024+16], cksum = 0;
+
+  buf[0] = MESSAGE_START;
+  buf[1] = seq;
+  buf[2] = n>>8;
+  buf[3] = n;
+  buf[4] = TOKEN;
+  memcpy(buf+5, body, n);
+  for(int i = 0; i < n+5; i++)
+    cksum ^= buf[i];
+  buf[n+5] = cksum;
+
+  return emu_send(e, buf, n+6);
+}
+
+// Emulate the result of the ISP serial command that stk500boot intercepts
+static uint8_t spi_emulate(Emu *e, const uint8_t *cmd) {
+  const Emu_part *p = e->part;
+
+  switch(cmd[0]) {
+  case 0x30:                    // Read signature byte
+    return p->sig[cmd[2] % 3];
+  case 0x50:                    // Read low or extended fuse
+    return cmd[1] == 0x08? p->fuses[2]: p->fuses[0];
+  case 0x58:                    // Read lock or high fuse
+    return cmd[1] == 0x08? p->fuses[1]: p->lock;
+  case 0xa0: {                  // Read EEPROM byte
+    uint8_t b;
+    emu_read_eeprom(e, cmd[1]<<8 | cmd[2], &b, 1);
+    return b;
+  }
+  default:
+    return 0;
+  }
+}
+
+// One STK500v2 message as understood by stk500boot
+static int stk500v2_cmd(Emu *e) {
+  uint8_t hdr[4], msg[1024+16], ans[1024+16], cksum;
+  int c, n, len;
+
+  do {                          // Wait for message start
+    if((c = emu_getc(e, -1)) < 0)
+      return c;
+  } while(c != MESSAGE_START);
+
+  if(emu_getn(e, hdr, 4, TIMEOUT_MS) < 0 || hdr[3] != TOKEN)
+    return 0;
+  n = hdr[1]<<8 | hdr[2];
+  if(n < 1 || n > (int) sizeof msg - 1 || emu_getn(e, msg, n+1, TIMEOUT_MS) < 0)
+    return 0;
+
+  cksum = MESSAGE_START ^ hdr[0] ^ hdr[1] ^ hdr[2] ^ hdr[3];
+  for(int i = 0; i <= n; i++)
+    cksum ^= msg[i];
+  if(cksum) {
+    emu_log(e, "checksum error\n");
+    ans[0] = ANSWER_CKSUM_ERROR;
+    ans[1] = STATUS_CKSUM_ERROR;
+    return stk500v2_reply(e, hdr[0], ans, 2);
+  }
+
+  e->sess.ncmds++;
+  ans[0] = msg[0];
+  ans[1] = STATUS_CMD_OK;
+  len = 2;
+
+  switch(msg[0]) {
+  case CMD_SIGN_ON:
+    ans[2] = 8;
+    memcpy(ans+3, "AVRISP_2", 8);
+    len = 11;
+    break;
+
+  case CMD_GET_PARAMETER:
+    ans[2] = msg[1] == PARAM_HW_VER? 0x0f: msg[1] == PARAM_SW_MAJOR? 2:
+      msg[1] == PARAM_SW_MINOR? 0x0a: 0;
+    len = 3;
+    break;
+
+  case CMD_LOAD_ADDRESS:
+    bl.addr = (msg[1]<<24 | msg[2]<<16 | msg[3]<<8 | msg[4]) & 0x7fffffff;
+    emu_log(e, "load address 0x%05x\n", bl.addr);
+    break;
+
+  case CMD_CHIP_ERASE_ISP:
+    emu_log(e, "chip erase\n");
+    emu_erase_flash(e, 0, bl.blstart);
+    break;
+
+  case CMD_PROGRAM_FLASH_ISP:
+  case CMD_PROGRAM_EEPROM_ISP: {
+    int nb = msg[1]<<8 | msg[2];
+    if(nb > n - 10) {
+      ans[1] = STATUS_CMD_FAILED;
+      break;
+    }
+    if(msg[0] == CMD_PROGRAM_FLASH_ISP) {
+      emu_log(e, "write F 0x%05x len %d\n", bl.addr*2, nb);
+      write_mem(e, 'F', bl.addr*2, msg+10, nb);
+      bl.addr += nb/2;
+    } else {
+      emu_log(e, "write E 0x%05x len %d\n", bl.addr, nb);
+      write_mem(e, 'E', bl.addr, msg+10, nb);
+      bl.addr += nb;
+    }
+    break;
+  }
+
+  case CMD_READ_FLASH_ISP:
+  case CMD_READ_EEPROM_ISP: {
+    int nb = msg[1]<<8 | msg[2];
+    if(nb > (int) sizeof ans - 3) {
+      ans[1] = STATUS_CMD_FAILED;
+      break;
+    }
+    if(msg[0] == CMD_READ_FLASH_ISP) {
+      emu_log(e, "read F 0x%05x len %d\n", bl.addr*2, nb);
+      read_mem(e, 'F', bl.addr*2, ans+2, nb);
+      bl.addr += nb/2;
+    } else {
+      emu_log(e, "read E 0x%05x len %d\n", bl.addr, nb);
+      read_mem(e, 'E', bl.addr, ans+2, nb);
+      bl.addr += nb;
+    }
+    ans[nb+2] = STATUS_CMD_OK;
+    len = nb+3;
+    break;
+  }
+
+  case CMD_READ_SIGNATURE_ISP:
+    ans[2] = e->part->sig[msg[4] % 3];
+    ans[3] = STATUS_CMD_OK;
+    len = 4;
+    break;
+
+  case CMD_READ_FUSE_ISP:
+  case CMD_READ_LOCK_ISP:
+    ans[2] = spi_emulate(e, msg+2);
+    ans[3] = STATUS_CMD_OK;
+    len = 4;
+    break;
+
+  case CMD_PROGRAM_FUSE_ISP:
+  case CMD_PROGRAM_LOCK_ISP:
+    ans[2] = STATUS_CMD_OK;
+    len = 3;
+    break;
+
+  case CMD_SPI_MULTI: {         // numTx, numRx, rxStartAddr, txData
+    uint8_t out[4] = {0, msg[4], msg[5], 0};
+    int nrx = msg[2] > 4? 4: msg[2], start = msg[3] > 3? 3: msg[3];
+    out[3] = spi_emulate(e, msg+4);
+    for(int i = 0; i < nrx; i++)
+      ans[2+i] = start+i < 4? out[start+i]: 0;
+    ans[2+nrx] = STATUS_CMD_OK;
+    len = nrx+3;
+    break;
+  }
+
+  case CMD_LEAVE_PROGMODE_ISP:
+    stk500v2_reply(e, hdr[0], ans, 2);
+    emu_session_end(e);
+    return 0;
+
+  case CMD_SET_PARAMETER:
+  case CMD_ENTER_PROGMODE_ISP:
+  case CMD_SET_DEVICE_PARAMETERS:
+  case CMD_OSCCAL:
+    break;
+
+  default:
+    emu_log(e, "unknown command 0x%02x\n", msg[0]);
+    ans[1] = STATUS_CMD_UNKNOWN;
+    break;
+  }
+
+  return stk500v2_reply(e, hdr[0], ans, len);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+    "Usage: %s [options]\n"
+    "Options:\n"
+    "  -c <protocol>  stk500v1 (optiboot, default), stk500v2 (wiring) or urclock (urboot)\n"
+    "  -p <part>      Emulated part, default m328p\n"
+    "  -b <baud>      Pace line at <baud>, 0 for no pacing; default follows the port rate\n"
+    "  -w <us>        Flash page write time, default 4500\n"
+    "  -e <us>        EEPROM byte write time, default 3400\n"
+    "  -E <us>        Chip erase time, default one page write time per page\n"
+    "  -l <path>      Create symlink <path> to the pty slave\n"
+    "  -v             Log each command to stderr\n"
+    "Parts:\n", name);
+  emu_list_parts();
+}
+
+int main(int argc, char **argv) {
+  Emu emu = {.baud = -1, .page_us = 4500, .eebyte_us = 3400, .erase_us = -1};
+  Protocol proto = P_STK500V1;
+  const char *partname = "m328p";
+  const Emu_part *part;
+  int c;
+
+  while((c = getopt(argc, argv, "c:p:b:w:e:E:l:vh")) != -1) {
+    switch(c) {
+    case 'c':
+      if(!strcmp(optarg, "stk500v1") || !strcmp(optarg, "arduino"))
+        proto = P_STK500V1;
+      else if(!strcmp(optarg, "stk500v2") || !strcmp(optarg, "wiring"))
+        proto = P_STK500V2;
+      else if(!strcmp(optarg, "urclock"))
+        proto = P_URCLOCK;
+      else {
+        fprintf(stderr, "unknown protocol %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'p':
+      partname = optarg;
+      break;
+    case 'b':
+      emu.baud = strtol(optarg, NULL, 0);
+      break;
+    case 'w':
+      emu.page_us = strtol(optarg, NULL, 0);
+      break;
+    case 'e':
+      emu.eebyte_us = strtol(optarg, NULL, 0);
+      break;
+    case 'E':
+      emu.erase_us = strtol(optarg, NULL, 0);
+      break;
+    case 'l':
+      emu.link = optarg;
+      break;
+    case 'v':
+      emu.verbose++;
+      break;
+    default:
+      usage(argv[0]);
+      return c != 'h';
+    }
+  }
+
+  if(!(part = emu_locate_part(partname))) {
+    fprintf(stderr, "unknown part %s\n", partname);
+    usage(argv[0]);
+    return 1;
+  }
+
+  if(emu_init(&emu, part) < 0 || emu_open_pty(&emu) < 0)
+    return 1;
+  init_bootloader(&emu, proto);
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  printf("%s\n", emu.slave);
+  fflush(stdout);
+
+  while(!emu_quit) {
+    int rc = proto == P_STK500V2? stk500v2_cmd(&emu): stk500v1_cmd(&emu, proto == P_URCLOCK);
+    if(rc == EMU_QUIT || rc == -1)
+      break;
+  }
+
+  emu_report(&emu);
+  emu_close(&emu);
+
+  return 0;
+}
@@ -0,0 +1,32 @@
+#
+# diff-tail.sh - differential writes also update pages of trailing 0xff
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+. "$(dirname "$0")/testlib.sh"
+
+fill "$TMP/a.bin" 1024 021
+fill "$TMP/b.bin" 512 042
+fill "$TMP/b.bin" 512 377
+
+start_emu bootemu stk500v2 m328p
+avrdude -c wiring -p m328p -P "$TTY" -U flash:w:"$TMP/a.bin":r || fail "writing a.bin"
+avrdude -c wiring -p m328p -P "$TTY" -U flash:d:"$TMP/b.bin":r || fail "differential write of b.bin"
+avrdude -c wiring -p m328p -P "$TTY" -U flash:r:"$TMP/rd.bin":r || fail "reading flash"
+stop_emu
+
+head -c 1024 "$TMP/rd.bin" | cmp -s - "$TMP/b.bin" || fail "trailing 0xff of b.bin not written"
+
+exit 0
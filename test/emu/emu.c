@@ -0,0 +1,413 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2024 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "emu.h"
+
+volatile int emu_quit;
+
+static const Emu_part parts[] = {
+  // name    mcuid  signature           flash   page eeprom boot  fuses (l, h, e)    lock
+  {"m328p",    119, {0x1e, 0x95, 0x0f}, 0x08000, 128, 0x0400, 512, {0xff, 0xd6, 0xfd}, 0xcf},
+  {"m32u4",     65, {0x1e, 0x95, 0x87}, 0x08000, 128, 0x0400, 512, {0xff, 0xd8, 0xcb}, 0xef},
+  {"m1284p",   141, {0x1e, 0x97, 0x05}, 0x20000, 256, 0x1000, 512, {0xf7, 0xde, 0xfd}, 0xcf},
+  {"m2560",    143, {0x1e, 0x98, 0x01}, 0x40000, 256, 0x1000, 512, {0xff, 0xd8, 0xfd}, 0xcf},
+};
+
+const Emu_part *emu_locate_part(const char *name) {
+  for(size_t i = 0; i < sizeof parts/sizeof *parts; i++)
+    if(strcasecmp(parts[i].name, name) == 0)
+      return parts+i;
+
+  return NULL;
+}
+
+void emu_list_parts(void) {
+  for(size_t i = 0; i < sizeof parts/sizeof *parts; i++)
+    fprintf(stderr, "  %-8s flash %6d, page %3d, EEPROM %4d\n", parts[i].name,
+      parts[i].flashsize, parts[i].pagesize, parts[i].eepromsize);
+}
+
+uint64_t emu_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static void sleep_until(uint64_t t) {
+  uint64_t now = emu_us();
+
+  if(t > now) {
+    struct timespec ts = {(t-now)/1000000, (t-now)%1000000*1000};
+    while(nanosleep(&ts, &ts) < 0 && errno == EINTR && !emu_quit)
+      continue;
+  }
+}
+
+void emu_log(const Emu *e, const char *fmt, ...) {
+  va_list ap;
+
+  if(!e->verbose)
+    return;
+  fprintf(stderr, "%10.3f ms: ", (emu_us() - e->total.tstart)/1000.0);
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+}
+
+int emu_init(Emu *e, const Emu_part *part) {
+  e->part = part;
+  e->flash = malloc(part->flashsize);
+  e->eeprom = malloc(part->eepromsize);
+  if(!e->flash || !e->eeprom) {
+    fprintf(stderr, "out of memory\n");
+    return -1;
+  }
+  memset(e->flash, 0xff, part->flashsize);
+  memset(e->eeprom, 0xff, part->eepromsize);
+  e->total.tstart = emu_us();
+
+  return 0;
+}
+
+// Rate of the slave as set by avrdude via tcsetattr()
+static long port_baud(const Emu *e) {
+  static const struct { speed_t sp; long baud; } rates[] = {
+    {B300, 300}, {B1200, 1200}, {B2400, 2400}, {B4800, 4800}, {B9600, 9600},
+    {B19200, 19200}, {B38400, 38400}, {B57600, 57600}, {B115200, 115200},
+#ifdef B230400
+    {B230400, 230400},
+#endif
+#ifdef B460800
+    {B460800, 460800},
+#endif
+#ifdef B500000
+    {B500000, 500000},
+#endif
+#ifdef B921600
+    {B921600, 921600},
+#endif
+#ifdef B1000000
+    {B1000000, 1000000},
+#endif
+#ifdef B1500000
+    {B1500000, 1500000},
+#endif
+#ifdef B2000000
+    {B2000000, 2000000},
+#endif
+#ifdef B3000000
+    {B3000000, 3000000},
+#endif
+  };
+  struct termios t;
+
+  if(tcgetattr(e->sfd, &t) == 0) {
+    speed_t sp = cfgetospeed(&t);
+    for(size_t i = 0; i < sizeof rates/sizeof *rates; i++)
+      if(rates[i].sp == sp)
+        return rates[i].baud;
+  }
+
+  return 115200;
+}
+
+// Current line rate: as set by -b or, with -b -1, as opened by avrdude
+long emu_baud(Emu *e) {
+  return e->baud < 0? port_baud(e): e->baud;
+}
+
+static void set_bytetime(Emu *e) {
+  long baud = emu_baud(e);
+
+  e->bytetime = baud > 0? (e->framebits? e->framebits: 10)*1e6/baud: 0;
+}
+
+int emu_open_pty(Emu *e) {
+  struct termios t;
+  const char *name;
+
+  if((e->mfd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(e->mfd) < 0 ||
+    unlockpt(e->mfd) < 0 || !(name = ptsname(e->mfd))) {
+
+    perror("cannot create pseudo terminal");
+    return -1;
+  }
+  snprintf(e->slave, sizeof e->slave, "%s", name);
+
+  // Keep the slave open so avrdude closing its end does not hang up the master
+  if((e->sfd = open(e->slave, O_RDWR | O_NOCTTY)) < 0) {
+    perror(e->slave);
+    return -1;
+  }
+  if(tcgetattr(e->sfd, &t) == 0) {
+    cfmakeraw(&t);
+    cfsetspeed(&t, B115200);
+    tcsetattr(e->sfd, TCSANOW, &t);
+  }
+
+  if(e->link) {
+    unlink(e->link);
+    if(symlink(e->slave, e->link) < 0) {
+      perror(e->link);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+void emu_close(Emu *e) {
+  if(e->link)
+    unlink(e->link);
+  close(e->mfd);
+  close(e->sfd);
+  free(e->flash);
+  free(e->eeprom);
+}
+
+static uint8_t rbuf[4096];
+static int rhead, rtail;
+
+static uint8_t ebuf[4096];      // Bytes received but not yet echoed back
+static int elen;
+
+// A single-wire line echoes each byte as soon as it has been clocked in
+static void echo_flush(Emu *e) {
+  if(elen) {
+    sleep_until(e->clock);
+    for(int done = 0, w; done < elen; done += w)
+      if((w = write(e->mfd, ebuf+done, elen-done)) < 0) {
+        if(errno != EINTR && errno != EAGAIN) {
+          perror("write()");
+          break;
+        }
+        w = 0;
+      }
+    elen = 0;
+  }
+}
+
+/*
+ * Return next byte from host, EMU_TIMEOUT or EMU_QUIT; timeout_ms < 0 waits
+ * indefinitely. Each byte received advances the target clock by one byte
+ * time, so replies cannot leave before the command could have arrived.
+ */
+int emu_getc(Emu *e, int timeout_ms) {
+  if(rhead == rtail) {
+    echo_flush(e);
+
+    struct pollfd pfd = {e->mfd, POLLIN, 0};
+    uint64_t deadline = emu_us() + (uint64_t) timeout_ms*1000;
+    int n, pending = poll(&pfd, 1, 0) > 0;
+
+    for(;;) {
+      int ms = timeout_ms < 0? 100: (int) ((deadline - emu_us() + 999)/1000);
+      if(emu_quit)
+        return EMU_QUIT;
+      if(timeout_ms >= 0 && emu_us() >= deadline)
+        return EMU_TIMEOUT;
+      n = poll(&pfd, 1, ms > 100? 100: ms);
+      if(n < 0 && errno != EINTR) {
+        perror("poll()");
+        return EMU_QUIT;
+      }
+      if(n > 0)
+        break;
+    }
+
+    if((n = read(e->mfd, rbuf, sizeof rbuf)) <= 0) {
+      if(n < 0 && (errno == EINTR || errno == EAGAIN))
+        return EMU_TIMEOUT;
+      perror("read()");
+      return EMU_QUIT;
+    }
+    rhead = 0;
+    rtail = n;
+
+    uint64_t now = emu_us();
+    if(e->baud)
+      set_bytetime(e);
+    if(e->clock < now)
+      e->clock = now;
+    // Data already waiting behind a buffering bridge followed the last byte on the line
+    if(!(e->rxbuffered && pending) && e->rxclock < now)
+      e->rxclock = now;
+  }
+
+  if(!e->sess.nrx++)
+    e->sess.tstart = emu_us();
+  if(e->rxbuffered) {
+    e->rxclock += e->bytetime;
+    if(e->clock < e->rxclock)
+      e->clock = e->rxclock;
+  } else
+    e->clock += e->bytetime;
+  if(e->echo) {
+    if(elen == (int) sizeof ebuf)
+      echo_flush(e);
+    ebuf[elen++] = rbuf[rhead];
+  }
+
+  return rbuf[rhead++];
+}
+
+// Read n bytes; return 0 on success, EMU_TIMEOUT or EMU_QUIT otherwise
+int emu_getn(Emu *e, uint8_t *buf, int n, int timeout_ms) {
+  for(int i = 0, c; i < n; i++) {
+    if((c = emu_getc(e, timeout_ms)) < 0)
+      return c;
+    buf[i] = c;
+  }
+
+  return 0;
+}
+
+// Transmit to host paced at the line rate in chunks of 16 bytes
+int emu_send(Emu *e, const uint8_t *buf, int n) {
+  echo_flush(e);
+
+  uint64_t now = emu_us();
+
+  if(e->clock < now)
+    e->clock = now;
+
+  while(n > 0) {
+    int chunk = n < 16? n: 16;
+
+    e->clock += chunk*e->bytetime;
+    sleep_until(e->clock);
+    for(int done = 0, w; done < chunk; done += w)
+      if((w = write(e->mfd, buf+done, chunk-done)) < 0) {
+        if(errno == EINTR || errno == EAGAIN) {
+          w = 0;
+          continue;
+        }
+        perror("write()");
+        return -1;
+      }
+    e->sess.ntx += chunk;
+    buf += chunk;
+    n -= chunk;
+  }
+
+  return 0;
+}
+
+// Target is busy for us microseconds, eg, programming NVM
+void emu_busy(Emu *e, long us) {
+  uint64_t now = emu_us();
+
+  if(e->clock < now)
+    e->clock = now;
+  e->clock += us;
+}
+
+static void memrange(uint32_t size, uint32_t *addr, int *n) {
+  if(*addr >= size)
+    *addr = size, *n = 0;
+  else if(*addr + *n > size)
+    *n = size - *addr;
+}
+
+void emu_write_flash(Emu *e, uint32_t addr, const uint8_t *buf, int n) {
+  int pgsz = e->part->pagesize;
+  int npages = (addr%pgsz + n + pgsz-1)/pgsz;
+
+  memrange(e->part->flashsize, &addr, &n);
+  memcpy(e->flash+addr, buf, n);
+  e->sess.npgwr += npages;
+  emu_busy(e, npages*e->page_us);
+}
+
+void emu_write_eeprom(Emu *e, uint32_t addr, const uint8_t *buf, int n) {
+  memrange(e->part->eepromsize, &addr, &n);
+  memcpy(e->eeprom+addr, buf, n);
+  e->sess.npgwr++;
+  emu_busy(e, n*e->eebyte_us);
+}
+
+void emu_read_flash(Emu *e, uint32_t addr, uint8_t *buf, int n) {
+  int m = n;
+
+  memset(buf, 0xff, n);
+  memrange(e->part->flashsize, &addr, &m);
+  memcpy(buf, e->flash+addr, m);
+  e->sess.npgrd++;
+}
+
+void emu_read_eeprom(Emu *e, uint32_t addr, uint8_t *buf, int n) {
+  int m = n;
+
+  memset(buf, 0xff, n);
+  memrange(e->part->eepromsize, &addr, &m);
+  memcpy(buf, e->eeprom+addr, m);
+  e->sess.npgrd++;
+}
+
+// Erase flash [from, to); chip erase time defaults to a page write time per page
+void emu_erase_flash(Emu *e, uint32_t from, uint32_t to) {
+  if(to > (uint32_t) e->part->flashsize)
+    to = e->part->flashsize;
+  if(from < to)
+    memset(e->flash+from, 0xff, to-from);
+  emu_busy(e, e->erase_us >= 0? e->erase_us: (long) (to-from)/e->part->pagesize*e->page_us);
+}
+
+static void print_stats(const char *what, const struct emu_stats *s) {
+  double secs = (emu_us() - s->tstart)/1e6;
+
+  fprintf(stderr, "%s: %.3f s, %lu cmds, %lu bytes in, %lu bytes out, %lu pages written, "
+    "%lu pages read, %.1f kB/s\n", what, secs, s->ncmds, s->nrx, s->ntx, s->npgwr, s->npgrd,
+    secs > 0? (s->nrx + s->ntx)/secs/1000: 0.0);
+}
+
+// Host has left programming mode: report and accumulate session statistics
+void emu_session_end(Emu *e) {
+  char what[32];
+
+  snprintf(what, sizeof what, "session %d", ++e->nsess);
+  print_stats(what, &e->sess);
+  e->total.ncmds += e->sess.ncmds;
+  e->total.nrx += e->sess.nrx;
+  e->total.ntx += e->sess.ntx;
+  e->total.npgwr += e->sess.npgwr;
+  e->total.npgrd += e->sess.npgrd;
+  memset(&e->sess, 0, sizeof e->sess);
+}
+
+// Final report at exit
+void emu_report(Emu *e) {
+  if(e->sess.nrx)
+    emu_session_end(e);
+  if(e->nsess > 1)
+    print_stats("total", &e->total);
+}
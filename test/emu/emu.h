@@ -0,0 +1,95 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2024 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Common infrastructure for the pseudo-terminal based target emulators: a
+ * pty pair that avrdude opens through the normal serial code, baud-rate
+ * pacing of both line directions, simulated NVM busy times and an in-memory
+ * model of flash, EEPROM and fuses.
+ */
+
+#ifndef emu_h
+#define emu_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EMU_TIMEOUT  (-1)       // emu_getc() return values
+#define EMU_QUIT     (-2)
+
+typedef struct {
+  const char *name;             // Part name as used with avrdude -p
+  int mcuid;                    // Urclock/avrintel MCU id
+  uint8_t sig[3];
+  int flashsize, pagesize, eepromsize;
+  int bootsize;                 // Size of emulated bootloader at top of flash
+  uint8_t fuses[3], lock;       // Low, high, extended fuse and lock byte
+} Emu_part;
+
+typedef struct {
+  int mfd, sfd;                 // Master side of the pty, slave side kept open
+  char slave[256];
+  const char *link;             // Optional symlink to the slave
+  long baud;                    // Pacing rate; 0: none; -1: follow port settings
+  int framebits;                // Bits per character on the line, default 10 (8N1)
+  int echo;                     // Single-wire line: host receives its own bytes back
+  int rxbuffered;               // Host bytes keep arriving while the target is busy
+  double bytetime;              // Transmission time of one byte in us
+  long page_us, eebyte_us, erase_us; // Simulated NVM busy times
+  uint64_t clock;               // Earliest time in us at which target can transmit
+  uint64_t rxclock;             // Time in us at which the last host byte has arrived
+  const Emu_part *part;
+  uint8_t *flash, *eeprom;
+  int verbose;
+
+  // Statistics of current session and of the whole run
+  struct emu_stats {
+    unsigned long ncmds, nrx, ntx, npgwr, npgrd;
+    uint64_t tstart;
+  } sess, total;
+  int nsess;
+} Emu;
+
+const Emu_part *emu_locate_part(const char *name);
+void emu_list_parts(void);
+
+int emu_init(Emu *e, const Emu_part *part);
+int emu_open_pty(Emu *e);
+void emu_close(Emu *e);
+
+uint64_t emu_us(void);
+long emu_baud(Emu *e);
+int emu_getc(Emu *e, int timeout_ms);
+int emu_getn(Emu *e, uint8_t *buf, int n, int timeout_ms);
+int emu_send(Emu *e, const uint8_t *buf, int n);
+void emu_busy(Emu *e, long us);
+
+void emu_write_flash(Emu *e, uint32_t addr, const uint8_t *buf, int n);
+void emu_write_eeprom(Emu *e, uint32_t addr, const uint8_t *buf, int n);
+void emu_read_flash(Emu *e, uint32_t addr, uint8_t *buf, int n);
+void emu_read_eeprom(Emu *e, uint32_t addr, uint8_t *buf, int n);
+void emu_erase_flash(Emu *e, uint32_t from, uint32_t to);
+
+void emu_session_end(Emu *e);
+void emu_report(Emu *e);
+void emu_log(const Emu *e, const char *fmt, ...)
+  __attribute__ ((format (printf, 2, 3)));
+
+extern volatile int emu_quit;
+
+#endif
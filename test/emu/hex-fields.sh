@@ -0,0 +1,38 @@
+#
+# hex-fields.sh - Intel Hex and S-Record fields that strtoul() accepts still read
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+. "$(dirname "$0")/testlib.sh"
+
+# Bytes 0a 0b 0c 0d at address 0, written with a leading blank or sign in some fields
+printf ':040000000A0B0C0DCE\n:00000001FF\n' > "$TMP/plain.hex"
+printf ': 4000000 A+B0C0DCE\n:00000001FF\n' > "$TMP/lenient.hex"
+printf 'S10700000A0B0C0DCA\nS9030000FC\n' > "$TMP/plain.srec"
+printf 'S1070000 A+B0C0DCA\nS9030000FC\n' > "$TMP/lenient.srec"
+printf '\012\013\014\015' > "$TMP/expect.bin"
+
+for f in plain.hex lenient.hex plain.srec lenient.srec; do
+  fmt=i; case $f in *.srec) fmt=s;; esac
+  avrdude -c dryrun -p m328p -U flash:w:"$TMP/$f":$fmt -U flash:r:"$TMP/$f.bin":r ||
+    fail "reading $f"
+  head -c 4 "$TMP/$f.bin" | cmp -s - "$TMP/expect.bin" || fail "wrong contents from $f"
+done
+
+# Non-hex characters other than a leading blank or sign are still rejected
+printf ':04000000 A0BxC0DCE\n:00000001FF\n' > "$TMP/bad.hex"
+avrdude -c dryrun -p m328p -U flash:w:"$TMP/bad.hex":i 2>/dev/null && fail "accepted bad.hex"
+
+exit 0
@@ -0,0 +1,42 @@
+#
+# paged-runs.sh - multi-page paged writes with blank pages inside a run
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+. "$(dirname "$0")/testlib.sh"
+
+# 40 pages of 128 bytes: data with all-0xff pages at the start, in the middle and across runs
+for v in 377 021 022 023 377 024 025 026 027 030 031 032 033 034 035 036 037 040 041 042 \
+  043 044 045 046 047 050 051 052 053 054 055 377 377 056 057 060 377 061 062 063; do
+  fill "$TMP/a.bin" 128 $v
+done
+
+# Write and verify a.bin: run_test <emulator> <protocol> <part> <avrdude -p part> <avrdude -c programmer> [<option>]
+run_test() {
+  start_emu "$1" "$2" "$3"
+  avrdude -c "$5" -p "$4" -P "$TTY" $6 -U flash:w:"$TMP/a.bin":r || fail "writing with -c $5 $6"
+  stop_emu
+}
+
+# Each programmer that sets pgm->paged_max
+run_test bootemu stk500v2 m328p m328p stk500v2
+run_test bootemu stk500v2 m328p m328p wiring
+run_test bootemu stk500v1 m328p m328p arduino
+run_test bootemu urclock m328p m328p urclock
+run_test updiemu serialupdi 128da48 avr128da48 serialupdi
+run_test updiemu jtag2updi 128da48 avr128da48 jtag2updi
+run_test updiemu jtag2updi 128da48 avr128da48 jtag2updi -xpipeline
+
+exit 0
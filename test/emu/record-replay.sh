@@ -0,0 +1,44 @@
+#
+# record-replay.sh - a session recorded with -P record: replays without target
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+. "$(dirname "$0")/testlib.sh"
+
+fill "$TMP/a.bin" 1000 021
+fill "$TMP/a.bin" 1000 042
+fill "$TMP/b.bin" 2000 063
+
+start_emu bootemu stk500v2 m328p
+avrdude -c wiring -p m328p -P "record:$TMP/log:$TTY" -U flash:w:"$TMP/a.bin":r ||
+  fail "recording a write"
+avrdude -c wiring -p m328p -P "$TTY" -U flash:r:"$TMP/rd.bin":r || fail "reading flash"
+stop_emu
+
+head -c 2000 "$TMP/rd.bin" | cmp -s - "$TMP/a.bin" || fail "flash differs from written file"
+
+# Replaying the same command succeeds without emulator
+avrdude -c wiring -p m328p -P "replay:$TMP/log" -U flash:w:"$TMP/a.bin":r ||
+  fail "replay of the recorded write"
+
+# Other data than recorded make the replay fail
+avrdude -c wiring -p m328p -P "replay:$TMP/log" -U flash:w:"$TMP/b.bin":r 2>/dev/null &&
+  fail "replay accepted data that differ from the recording"
+
+# Recording from a port that cannot be opened fails cleanly
+avrdude -c wiring -p m328p -P "record:$TMP/log2:$TMP/nonexistent" -U flash:r:"$TMP/x.bin":r 2>/dev/null &&
+  fail "recording from a nonexistent port"
+
+exit 0
@@ -0,0 +1,34 @@
+#
+# reference-write.sh - -U :w: with -R clears what the reference has beyond the new file
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+. "$(dirname "$0")/testlib.sh"
+
+fill "$TMP/old.bin" 2048 063
+fill "$TMP/new.bin" 512 104
+cp "$TMP/new.bin" "$TMP/expect.bin"
+fill "$TMP/expect.bin" 1536 377
+
+start_emu bootemu stk500v2 m328p
+avrdude -c wiring -p m328p -P "$TTY" -U flash:w:"$TMP/old.bin":r || fail "writing old.bin"
+avrdude -c wiring -p m328p -P "$TTY" -R "$TMP/old.bin":r -U flash:w:"$TMP/new.bin":r ||
+  fail "writing new.bin against reference old.bin"
+avrdude -c wiring -p m328p -P "$TTY" -U flash:r:"$TMP/rd.bin":r || fail "reading flash"
+stop_emu
+
+head -c 2048 "$TMP/rd.bin" | cmp -s - "$TMP/expect.bin" || fail "flash beyond new.bin not cleared"
+
+exit 0
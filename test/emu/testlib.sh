@@ -0,0 +1,64 @@
+#
+# testlib.sh - common functions of the emulator regression tests
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+#
+
+# Sourced by the tests, which ctest calls as <test>.sh <avrdude> <avrdude.conf> <emulator dir>
+
+AVRDUDE=$1
+AVRDUDE_CONF=$2
+EMUDIR=$3
+TMP=$(mktemp -d "${TMPDIR:-/tmp}/avrdude-test.XXXXXX") || exit 1
+TTY=$TMP/tty
+EMUPID=
+
+cleanup() {
+  [ -n "$EMUPID" ] && kill "$EMUPID" 2>/dev/null
+  rm -rf "$TMP"
+}
+trap cleanup EXIT
+
+fail() {
+  echo "FAIL: $*" >&2
+  [ -f "$TMP/emu.err" ] && tail -5 "$TMP/emu.err" >&2
+  exit 1
+}
+
+# Start an unpaced emulator: start_emu <bootemu|updiemu> <protocol> <part>
+start_emu() {
+  "$EMUDIR/$1" -c "$2" -p "$3" -b 0 -l "$TTY" 2>"$TMP/emu.err" &
+  EMUPID=$!
+  for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20; do
+    [ -e "$TTY" ] && return 0
+    sleep 0.1
+  done
+  fail "emulator $1 -c $2 did not start"
+}
+
+stop_emu() {
+  kill "$EMUPID" 2>/dev/null
+  wait "$EMUPID" 2>/dev/null
+  EMUPID=
+  rm -f "$TTY"
+}
+
+avrdude() {
+  "$AVRDUDE" -C "$AVRDUDE_CONF" -qq "$@"
+}
+
+# Append n bytes of octal value v to a file: fill <file> <n> <v>, eg, fill a.bin 512 377
+fill() {
+  head -c "$2" /dev/zero | tr '\0' "\\$3" >> "$1"
+}
@@ -0,0 +1,1128 @@
+/*
+ * avrdude - A Downloader/Uploader for AVR device programmers
+ * Copyright (C) 2024 The AVRDUDE authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * UPDI target emulator on a pseudo terminal for benchmarking and testing
+ * avrdude's UPDI programmers without a board:
+ *
+ *  - serialupdi: the pty is the single-wire UPDI line of a USB-serial
+ *    adapter, ie, every byte sent is echoed back; the target implements
+ *    SYNC, LDS/STS, LD/ST with pointer and REPEAT, LDCS/STCS, KEY and SIB
+ *    including guard time, inter-byte delay and response signature disable
+ *  - jtag2updi: the pty carries JTAGICE mkII frames to a bridge that drives
+ *    the same target model; the bridge's UPDI traffic is accounted for as
+ *    busy time at the bridge's UPDI rate
+ *
+ * The NVM controller versions 0 (tinyAVR, megaAVR-0), 2 (AVR-Dx), 3 (AVR-Ex),
+ * 4 (AVR-DU) and 5 (AVR-EB) are modelled with their commands, page buffer
+ * semantics, busy flags and command collision errors. Example:
+ *
+ *   updiemu -p m4809 -l /tmp/ttyUPDI &
+ *   avrdude -c serialupdi -p m4809 -P /tmp/ttyUPDI -U flash:w:blink.hex
+ *
+ * Each time avrdude disables UPDI (serialupdi) or signs off (jtag2updi) the
+ * emulator prints the session statistics.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "emu.h"
+#include "crc16.h"
+#include "jtagmkII_private.h"
+#include "updi_constants.h"
+
+#define UPDI_CTRLA_RSD_BIT        3
+#define UPDI_ASI_CTRLA_CLKSEL     0x03
+
+#define TIMEOUT_MS 500          // Abandon partially received instruction after this time
+#define BRIDGE_BAUD 225000      // UPDI rate of the jtag2updi firmware
+
+typedef enum { P_SERIALUPDI, P_JTAG2UPDI } Protocol;
+
+typedef struct {
+  Emu_part p;                   // Only name, signature, flash, page and EEPROM sizes are used
+  int nvm;                      // NVM controller version
+  const char *family;           // Family ID as shown in the SIB
+  uint32_t flash;               // Flash offset in data space
+  uint16_t nvmctrl, syscfg, sigrow, fuses, lock, userrow;
+  int nlock, userrowsize, eepagesize;
+  uint8_t fuse[16];             // Factory fuse values
+} Updi_part;
+
+// From the respective avrdude.conf.in entries
+static const Updi_part parts[] = {
+  {{.name = "t1614", .mcuid = 307, .sig = {0x1e, 0x94, 0x22},
+    .flashsize = 0x04000, .pagesize = 64, .eepromsize = 256},
+    0, "tinyAVR", 0x008000,
+    0x1000, 0x0f00, 0x1100, 0x1280, 0x128a, 0x1300, 1,  32, 32, {0, 0, 0x7e, 0, 0, 0xf6, 0xff}},
+  {{.name = "m4809", .mcuid = 326, .sig = {0x1e, 0x96, 0x51},
+    .flashsize = 0x0c000, .pagesize = 128, .eepromsize = 256},
+    0, "megaAVR", 0x004000,
+    0x1000, 0x0f00, 0x1100, 0x1280, 0x128a, 0x1300, 1,  64, 64, {0, 0, 0x7e, 0, 0, 0xf6, 0xff}},
+  {{.name = "128da48", .mcuid = 368, .sig = {0x1e, 0x97, 0x08},
+    .flashsize = 0x20000, .pagesize = 512, .eepromsize = 512},
+    2, "AVR", 0x800000,
+    0x1000, 0x0f00, 0x1100, 0x1050, 0x1040, 0x1080, 4,  32,  1, {0, 0, 0, 0, 0, 0xc0, 0x08}},
+  {{.name = "64ea48", .mcuid = 361, .sig = {0x1e, 0x96, 0x1e},
+    .flashsize = 0x10000, .pagesize = 128, .eepromsize = 512},
+    3, "AVR", 0x800000,
+    0x1000, 0x0f00, 0x1100, 0x1050, 0x1040, 0x1080, 4,  64,  8, {0, 0, 0, 0, 0, 0xd0, 0x07}},
+  {{.name = "64du32", .mcuid = 385, .sig = {0x1e, 0x96, 0x21},
+    .flashsize = 0x10000, .pagesize = 512, .eepromsize = 256},
+    4, "AVR", 0x800000,
+    0x1000, 0x0f00, 0x1080, 0x1050, 0x1040, 0x1200, 4, 512,  1, {0, 0, 0, 0, 0, 0xd0, 0x08}},
+  {{.name = "16eb32", .mcuid = 383, .sig = {0x1e, 0x94, 0x3e},
+    .flashsize = 0x04000, .pagesize = 64, .eepromsize = 512},
+    5, "AVR", 0x800000,
+    0x1000, 0x0f00, 0x1080, 0x1050, 0x1040, 0x1200, 4,  64,  8, {0, 0, 0, 0, 0, 0xd0, 0x07}},
+};
+
+// Typical NVM timing in us by controller version
+static const struct {
+  long page, pgerase, eewrite, chiperase;
+} nvm_times[] = {
+  [0] = { 2000,  2000,  4000,  4000}, // Page write, page erase, EEPROM page, chip erase
+  [2] = {17920, 10000, 11000, 25000}, // Flash written word by word, EEPROM byte by byte
+  [3] = { 2500,  8000, 10500, 10000},
+  [4] = {17920, 10000, 11000, 25000},
+  [5] = { 2500,  8000, 10500, 10000},
+};
+
+// NVMCTRL registers and commands
+#define V0_CTRLA     0x00
+#define V0_STATUS    0x02
+#define V0_DATA      0x06
+#define V0_ADDR      0x08
+#define V0_WP        0x01
+#define V0_ER        0x02
+#define V0_ERWP      0x03
+#define V0_PBC       0x04
+#define V0_CHER      0x05
+#define V0_EEER      0x06
+#define V0_WFU       0x07
+
+#define Vx_CTRLA     0x00       // NVM v2 and up
+#define V2_STATUS    0x02
+#define V2_ADDR      0x08
+#define V3_STATUS    0x06
+#define V3_ADDR      0x0c
+#define Vx_NOCMD     0x00
+#define Vx_NOOP      0x01
+#define Vx_FLWR      0x02       // v2, v4
+#define Vx_FLPW      0x04       // v3, v5
+#define Vx_FLPERW    0x05
+#define Vx_FLPER     0x08
+#define Vx_FLPBC     0x0f
+#define Vx_EEWR      0x12
+#define Vx_EEERWR    0x13
+#define Vx_EEPW      0x14
+#define Vx_EEPERW    0x15
+#define Vx_EEPER     0x17
+#define Vx_EEBER     0x18
+#define Vx_EEPBC     0x1f
+#define Vx_CHER      0x20
+#define Vx_EECHER    0x30
+
+#define ERR_CMDCOLLISION 3
+
+// CRCSCAN registers and bits
+#define CRCSCAN        0x0120
+#define CRC_CTRLA      0x00
+#define CRC_CTRLB      0x01
+#define CRC_STATUS     0x02
+#define CRC_ENABLE     0x01
+#define CRC_RESET      0x80
+#define CRC_BUSY       0x01
+#define CRC_OK         0x02
+
+typedef enum { R_NONE, R_FLASH, R_EEPROM, R_USERROW, R_FUSE, R_LOCK, R_NVMCTRL, R_DATA } Region;
+
+static struct {
+  const Updi_part *up;
+  uint8_t ds[0x10000];          // I/O, NVMCTRL, SIGROW, fuses, lock, USERROW and SRAM
+  char sib[32];
+
+  // UPDI
+  uint8_t cs[16];               // Control and status registers
+  uint8_t keys;                 // Keys received, as in ASI_KEY_STATUS
+  int disabled, reset, progmode, urowprog, locked;
+  uint32_t ptr;
+  int repeat;
+
+  // NVM controller
+  uint8_t cmd, err;
+  uint32_t addr;                // Latched address of last NVM write
+  uint64_t fbusy, eebusy;       // Target time at which flash and EEPROM become ready
+  uint8_t pgbuf[512], pgset[512];
+  long page_us, pgerase_us, eewrite_us, erase_us;
+
+  // CRCSCAN
+  uint64_t crcbusy;             // Target time at which the scan finishes
+  int crcok;
+} tg;
+
+static void on_signal(int sig) {
+  (void) sig;
+  emu_quit = 1;
+}
+
+static const Updi_part *locate_part(const char *name) {
+  for(size_t i = 0; i < sizeof parts/sizeof *parts; i++)
+    if(strcasecmp(parts[i].p.name, name) == 0)
+      return parts+i;
+
+  return NULL;
+}
+
+static void list_parts(void) {
+  for(size_t i = 0; i < sizeof parts/sizeof *parts; i++)
+    fprintf(stderr, "  %-8s flash %6d, page %3d, EEPROM %4d, NVM v%d\n", parts[i].p.name,
+      parts[i].p.flashsize, parts[i].p.pagesize, parts[i].p.eepromsize, parts[i].nvm);
+}
+
+static int is_unlocked(void) {
+  const uint8_t *lb = tg.ds + tg.up->lock;
+
+  return tg.up->nlock == 1? lb[0] == 0xc5: lb[0] == 0x5c && lb[1] == 0xc5 && lb[2] == 0xc5 && lb[3] == 0x5c;
+}
+
+static void init_target(Emu *e, const Updi_part *up, int locked) {
+  tg.up = up;
+  memset(tg.ds + up->sigrow, 0xff, 128);
+  memcpy(tg.ds + up->sigrow, up->p.sig, 3);
+  for(int i = 3; i < 32; i++)   // Made-up serial number covering both SIGROW layouts
+    tg.ds[up->sigrow + i] = 0x50 + i;
+  memcpy(tg.ds + up->fuses, up->fuse, sizeof up->fuse);
+  memset(tg.ds + up->userrow, 0xff, up->userrowsize);
+  if(up->nlock == 1)
+    tg.ds[up->lock] = locked? 0x00: 0xc5;
+  else
+    memcpy(tg.ds + up->lock, locked? "\0\0\0\0": "\x5c\xc5\xc5\x5c", 4);
+  tg.ds[up->syscfg+1] = 0x10;   // Silicon revision B0
+  tg.locked = !is_unlocked();
+
+  // SIB: family, NVM version, OCD version, oscillator and extra info
+  char sib[40];
+  snprintf(sib, sizeof sib, "%7s P:%dD:1-3M2 (A3.KV00S.0)", up->family, up->nvm);
+  memcpy(tg.sib, sib, sizeof tg.sib);
+
+  tg.cs[UPDI_CS_STATUSA] = up->nvm? 0x30: 0x10; // UPDI revision
+  tg.cs[UPDI_ASI_CTRLA] = 3;    // UPDI clock 4 MHz
+
+  tg.page_us = e->page_us >= 0? e->page_us: nvm_times[up->nvm].page;
+  tg.pgerase_us = nvm_times[up->nvm].pgerase;
+  tg.eewrite_us = e->eebyte_us >= 0? e->eebyte_us: nvm_times[up->nvm].eewrite;
+  tg.erase_us = e->erase_us >= 0? e->erase_us: nvm_times[up->nvm].chiperase;
+}
+
+// Which memory does data space address addr belong to? *off is offset within
+static Region region(uint32_t addr, uint32_t *off) {
+  const Updi_part *up = tg.up;
+  uint32_t o;
+
+  if((o = addr - up->flash) < (uint32_t) up->p.flashsize)
+    return *off = o, R_FLASH;
+  if(addr >= 0x10000)
+    return R_NONE;
+  if((o = addr - 0x1400) < (uint32_t) up->p.eepromsize)
+    return *off = o, R_EEPROM;
+  if((o = addr - up->userrow) < (uint32_t) up->userrowsize)
+    return *off = o, R_USERROW;
+  if((o = addr - up->lock) < (uint32_t) up->nlock)
+    return *off = o, R_LOCK;
+  if((o = addr - up->fuses) < 16)
+    return *off = o, R_FUSE;
+  if((o = addr - up->nvmctrl) < 0x40)
+    return *off = o, R_NVMCTRL;
+
+  return *off = addr, R_DATA;
+}
+
+// NVM busy flags as seen at the current target time
+static uint8_t nvm_status(Emu *e) {
+  int fb = e->clock < tg.fbusy, eb = e->clock < tg.eebusy;
+
+  switch(tg.up->nvm) {
+  case 0:
+    return fb | eb<<1 | (tg.err? 4: 0);
+  case 4:                       // EEBUSY and FBUSY swapped
+    return eb | fb<<1 | tg.err<<4;
+  default:
+    return fb | eb<<1 | tg.err<<4;
+  }
+}
+
+static void nvm_busy(Emu *e, uint64_t *until, long us) {
+  uint64_t t = e->clock > *until? e->clock: *until;
+
+  *until = t + us;
+}
+
+// Writes to NVM while the controller is busy stall the bus until it is ready
+static void nvm_stall(Emu *e, uint64_t until) {
+  if(e->clock < until)
+    e->clock = until;
+}
+
+static void chip_erase(Emu *e) {
+  memset(e->flash, 0xff, e->part->flashsize);
+  memset(e->eeprom, 0xff, e->part->eepromsize);
+  if(tg.up->nlock == 1)
+    tg.ds[tg.up->lock] = 0xc5;
+  else
+    memcpy(tg.ds + tg.up->lock, "\x5c\xc5\xc5\x5c", 4);
+  tg.locked = 0;
+  nvm_busy(e, &tg.fbusy, tg.erase_us);
+  nvm_busy(e, &tg.eebusy, tg.erase_us);
+  emu_log(e, "chip erase\n");
+}
+
+static void flash_page_erase(Emu *e, uint32_t off) {
+  int pgsz = e->part->pagesize;
+
+  memset(e->flash + off/pgsz*pgsz, 0xff, pgsz);
+  nvm_busy(e, &tg.fbusy, tg.pgerase_us);
+}
+
+// Program one byte of EEPROM-like memory; erase: erase before write, write: program
+static void ee_program(Emu *e, uint32_t addr, uint8_t val, int erase, int write) {
+  uint32_t off;
+  uint8_t *b;
+
+  switch(region(addr, &off)) {
+  case R_EEPROM:
+    b = e->eeprom + off;
+    break;
+  case R_USERROW: case R_FUSE: case R_LOCK:
+    b = tg.ds + addr;
+    break;
+  default:
+    return;
+  }
+  if(erase)
+    *b = 0xff;
+  if(write)
+    *b &= val;
+}
+
+// Commit page buffer to the page that contains the latched address
+static void pgbuf_commit(Emu *e, int erase, int write, int eelike) {
+  int bufsz = e->part->pagesize;
+  uint32_t base = tg.addr/bufsz*bufsz, off;
+
+  if(!eelike && region(tg.addr, &off) == R_FLASH) {
+    if(erase)
+      memset(e->flash + off/bufsz*bufsz, 0xff, bufsz);
+    for(int i = 0; write && i < bufsz; i++)
+      if(tg.pgset[i])
+        e->flash[off/bufsz*bufsz + i] &= tg.pgbuf[i];
+    nvm_busy(e, &tg.fbusy, (erase? tg.pgerase_us: 0) + (write? tg.page_us: 0));
+  } else {                      // EEPROM-like memories only change bytes that were loaded
+    for(int i = 0; i < bufsz; i++)
+      if(tg.pgset[i])
+        ee_program(e, base + i, tg.pgbuf[i], erase, write);
+    nvm_busy(e, &tg.eebusy, tg.eewrite_us);
+  }
+  memset(tg.pgset, 0, sizeof tg.pgset);
+  e->sess.npgwr++;
+}
+
+static int is_mode_cmd(uint8_t cmd) {
+  switch(cmd) {
+  case Vx_FLWR: case Vx_FLPER: case Vx_EEWR: case Vx_EEERWR: case Vx_EEBER: case Vx_EEPER:
+    return 1;
+  }
+  return 0;
+}
+
+static void nvm_command(Emu *e, uint8_t cmd) {
+  emu_log(e, "NVM command 0x%02x\n", cmd);
+
+  if(tg.up->nvm == 0) {
+    switch(cmd) {
+    case V0_WP:   pgbuf_commit(e, 0, 1, 0); break;
+    case V0_ER:   pgbuf_commit(e, 1, 0, 0); break;
+    case V0_ERWP: pgbuf_commit(e, 1, 1, 0); break;
+    case V0_PBC:  memset(tg.pgset, 0, sizeof tg.pgset); break;
+    case V0_CHER: chip_erase(e); break;
+    case V0_EEER:
+      memset(e->eeprom, 0xff, e->part->eepromsize);
+      nvm_busy(e, &tg.eebusy, tg.eewrite_us);
+      break;
+    case V0_WFU:
+      ee_program(e, tg.ds[tg.up->nvmctrl + V0_ADDR] | tg.ds[tg.up->nvmctrl + V0_ADDR+1]<<8,
+        tg.ds[tg.up->nvmctrl + V0_DATA], 1, 1);
+      nvm_busy(e, &tg.eebusy, tg.eewrite_us);
+      break;
+    }
+    return;
+  }
+
+  if(cmd == Vx_NOCMD) {
+    tg.cmd = cmd;
+    tg.err = 0;
+    return;
+  }
+  if(cmd == Vx_NOOP)
+    return;
+  if(is_mode_cmd(tg.cmd)) {     // Must write NOCMD before changing the command
+    emu_log(e, "NVM command collision 0x%02x -> 0x%02x\n", tg.cmd, cmd);
+    tg.err = ERR_CMDCOLLISION;
+    return;
+  }
+  tg.cmd = cmd;
+
+  int pagewise = tg.up->nvm == 3 || tg.up->nvm == 5;
+  switch(cmd) {
+  case Vx_CHER:
+    chip_erase(e);
+    break;
+  case Vx_EECHER:
+    memset(e->eeprom, 0xff, e->part->eepromsize);
+    nvm_busy(e, &tg.eebusy, tg.eewrite_us);
+    break;
+  case Vx_FLPW:   if(pagewise) pgbuf_commit(e, 0, 1, 0); break;
+  case Vx_FLPERW: if(pagewise) pgbuf_commit(e, 1, 1, 0); break;
+  case Vx_EEPW:   if(pagewise) pgbuf_commit(e, 0, 1, 1); break;
+  case Vx_EEPERW: if(pagewise) pgbuf_commit(e, 1, 1, 1); break;
+  case Vx_FLPBC: case Vx_EEPBC:
+    memset(tg.pgset, 0, sizeof tg.pgset);
+    break;
+  }
+}
+
+// Store to a memory-mapped NVM location
+static void nvm_store(Emu *e, Region r, uint32_t addr, uint32_t off, uint8_t val) {
+  int pgsz = e->part->pagesize, nvm = tg.up->nvm;
+
+  if(tg.urowprog && r == R_USERROW) { // Locked-device user row write lands in a buffer
+    tg.pgbuf[off] = val;
+    tg.pgset[off] = 1;
+    return;
+  }
+
+  if(nvm == 0 || nvm == 3 || nvm == 5) {
+    if(nvm && (tg.cmd == Vx_FLPER || tg.cmd == Vx_EEPER)) {
+      if(r == R_FLASH || r == R_USERROW)
+        r == R_FLASH? flash_page_erase(e, off): memset(tg.ds + tg.up->userrow, 0xff, tg.up->userrowsize);
+      else
+        for(int i = 0, n = tg.up->eepagesize; i < n; i++)
+          ee_program(e, addr/n*n + i, 0xff, 1, 0);
+      return;
+    }
+    if(r == R_FUSE || r == R_LOCK) {
+      if(nvm == 0)              // Fuses are written with WFU through ADDR and DATA
+        return;
+    }
+    tg.pgbuf[addr % pgsz] = val;
+    tg.pgset[addr % pgsz] = 1;
+    tg.addr = addr;
+    return;
+  }
+
+  // NVM v2 and v4 write words and bytes directly
+  tg.addr = addr;
+  switch(tg.cmd) {
+  case Vx_FLWR:
+    if(r == R_FLASH) {
+      nvm_stall(e, tg.fbusy);
+      e->flash[off] &= val;
+      if(off & 1)
+        nvm_busy(e, &tg.fbusy, tg.page_us*2/pgsz);
+      if(off % pgsz == (uint32_t) pgsz-1)
+        e->sess.npgwr++;
+    } else if(r == R_USERROW) {
+      tg.ds[addr] &= val;
+      nvm_busy(e, &tg.fbusy, tg.page_us*2/pgsz);
+    }
+    break;
+  case Vx_FLPER:
+    if(r == R_FLASH)
+      flash_page_erase(e, off);
+    else if(r == R_USERROW) {
+      memset(tg.ds + tg.up->userrow, 0xff, tg.up->userrowsize);
+      nvm_busy(e, &tg.fbusy, tg.pgerase_us);
+    }
+    break;
+  case Vx_EEWR: case Vx_EEERWR: case Vx_EEBER:
+    if(r == R_EEPROM || r == R_FUSE || r == R_LOCK) {
+      nvm_stall(e, tg.eebusy);
+      ee_program(e, addr, val, tg.cmd != Vx_EEWR, tg.cmd != Vx_EEBER);
+      nvm_busy(e, &tg.eebusy, tg.eewrite_us);
+    }
+    break;
+  }
+}
+
+// Write to CRCSCAN.CTRLA: whole-flash CRC-16-CCITT scan at about 3 bytes per us
+static uint8_t crcscan(Emu *e, uint8_t ctrla) {
+  if(ctrla & CRC_RESET) {
+    tg.crcbusy = 0;
+    tg.crcok = 0;
+    tg.ds[CRCSCAN + CRC_CTRLB] = 0;
+    return 0;
+  }
+  if((ctrla & CRC_ENABLE) && !(tg.ds[CRCSCAN + CRC_CTRLA] & CRC_ENABLE)) {
+    tg.crcok = (tg.ds[CRCSCAN + CRC_CTRLB] & 3) == 0 && !crcccitt(e->flash, e->part->flashsize, 0xffff);
+    tg.crcbusy = e->clock + e->part->flashsize/3;
+  }
+  return ctrla;
+}
+
+static uint8_t tgt_read(Emu *e, uint32_t addr) {
+  uint32_t off;
+  Region r = region(addr, &off);
+
+  if(tg.locked && r != R_DATA && r != R_NVMCTRL)
+    return 0;
+
+  switch(r) {
+  case R_FLASH:
+    if(off % e->part->pagesize == 0)
+      e->sess.npgrd++;
+    return e->flash[off];
+  case R_EEPROM:
+    return e->eeprom[off];
+  case R_NVMCTRL:
+    if(off == (tg.up->nvm == 0 || tg.up->nvm == 2? V2_STATUS: V3_STATUS))
+      return nvm_status(e);
+    if(tg.up->nvm && off == Vx_CTRLA)
+      return tg.cmd;
+    return tg.ds[addr];
+  case R_NONE:
+    return 0xff;
+  case R_DATA:
+    if(addr == CRCSCAN + CRC_STATUS)
+      return e->clock < tg.crcbusy? CRC_BUSY: tg.crcok? CRC_OK: 0;
+    return tg.ds[addr];
+  default:
+    return tg.ds[addr];
+  }
+}
+
+static void tgt_write(Emu *e, uint32_t addr, uint8_t val) {
+  uint32_t off;
+  Region r = region(addr, &off);
+
+  if(tg.locked && r != R_DATA && r != R_NVMCTRL)
+    return;
+
+  switch(r) {
+  case R_NVMCTRL:
+    if(off == Vx_CTRLA)
+      nvm_command(e, val);
+    else
+      tg.ds[addr] = val;
+    break;
+  case R_DATA:
+    if(addr == CRCSCAN + CRC_CTRLA)
+      val = crcscan(e, val);
+    tg.ds[addr] = val;
+    break;
+  case R_NONE:
+    break;
+  default:
+    nvm_store(e, r, addr, off, val);
+  }
+}
+
+// Apply or release reset; on release, keys that have been received take effect
+static void updi_reset(Emu *e, int apply) {
+  if(apply) {
+    tg.reset = 1;
+    return;
+  }
+  if(!tg.reset)
+    return;
+  tg.reset = 0;
+  tg.cmd = 0;
+  tg.err = 0;
+  crcscan(e, CRC_RESET);
+  tg.ds[CRCSCAN + CRC_CTRLA] = 0;
+  memset(tg.pgset, 0, sizeof tg.pgset);
+  if(tg.keys & (1 << UPDI_ASI_KEY_STATUS_CHIPERASE)) {
+    chip_erase(e);
+    tg.keys &= ~(1 << UPDI_ASI_KEY_STATUS_CHIPERASE);
+  }
+  tg.locked = !is_unlocked();
+  if(tg.keys & (1 << UPDI_ASI_KEY_STATUS_NVMPROG) && !tg.locked)
+    tg.progmode = 1;
+  if(tg.keys & (1 << UPDI_ASI_KEY_STATUS_UROWWRITE)) {
+    tg.urowprog = 1;
+    memset(tg.pgset, 0, sizeof tg.pgset);
+  }
+}
+
+// Leaving programming mode: report session and return to power-on state of the UPDI
+static void updi_disable(Emu *e) {
+  tg.disabled = 1;
+  tg.keys = 0;
+  tg.progmode = tg.urowprog = 0;
+  tg.cs[UPDI_CS_CTRLA] = tg.cs[UPDI_CS_CTRLB] = 0;
+  if(e->sess.nrx)
+    emu_session_end(e);
+}
+
+static uint8_t cs_read(Emu *e, int reg) {
+  (void) e;
+  switch(reg) {
+  case UPDI_ASI_KEY_STATUS:
+    return tg.keys;
+  case UPDI_ASI_SYS_STATUS:
+    return tg.locked << UPDI_ASI_SYS_STATUS_LOCKSTATUS | tg.urowprog << UPDI_ASI_SYS_STATUS_UROWPROG |
+      tg.progmode << UPDI_ASI_SYS_STATUS_NVMPROG | tg.reset << UPDI_ASI_SYS_STATUS_RSTSYS;
+  default:
+    return tg.cs[reg];
+  }
+}
+
+static void cs_write(Emu *e, int reg, uint8_t val) {
+  switch(reg) {
+  case UPDI_CS_CTRLB:
+    tg.cs[reg] = val;
+    if(val & (1 << UPDI_CTRLB_UPDIDIS_BIT))
+      updi_disable(e);
+    break;
+  case UPDI_ASI_KEY_STATUS:     // Writing one clears the key
+    tg.keys &= ~val;
+    break;
+  case UPDI_ASI_RESET_REQ:
+    updi_reset(e, val == UPDI_RESET_REQ_VALUE);
+    break;
+  case UPDI_ASI_SYS_CTRLA:
+    if(val & (1 << UPDI_ASI_SYS_CTRLA_UROW_FINAL) && tg.urowprog) {
+      memset(tg.ds + tg.up->userrow, 0xff, tg.up->userrowsize);
+      for(int i = 0; i < tg.up->userrowsize; i++)
+        if(tg.pgset[i])
+          tg.ds[tg.up->userrow + i] = tg.pgbuf[i];
+      memset(tg.pgset, 0, sizeof tg.pgset);
+      nvm_busy(e, &tg.fbusy, tg.pgerase_us + tg.page_us);
+      e->sess.npgwr++;
+      tg.urowprog = 0;
+    }
+    break;
+  default:
+    tg.cs[reg] = val;
+  }
+}
+
+// Maximum UPDI rate for the UPDI clock selected in ASI_CTRLA
+static long max_baud(void) {
+  static const long fupdi[] = {32000000, 16000000, 8000000, 4000000};
+
+  return fupdi[tg.cs[UPDI_ASI_CTRLA] & UPDI_ASI_CTRLA_CLKSEL]/16;
+}
+
+// Guard time before the target drives the line plus inter-byte delays of a response
+static void turnaround(Emu *e, int nbytes) {
+  static const int gtbits[] = {128, 64, 32, 16, 8, 4, 2, 2};
+  double bit = e->bytetime/(e->framebits? e->framebits: 10);
+  int bits = gtbits[tg.cs[UPDI_CS_CTRLA] & 7];
+
+  if(tg.cs[UPDI_CS_CTRLA] & (1 << UPDI_CTRLA_IBDLY_BIT) && nbytes > 1)
+    bits += 2*(nbytes-1);
+  emu_busy(e, (long) (bits*bit));
+}
+
+static int respond(Emu *e, const uint8_t *buf, int n) {
+  turnaround(e, n);
+  return emu_send(e, buf, n);
+}
+
+static int ack(Emu *e) {
+  uint8_t a = UPDI_PHY_ACK;
+
+  return tg.cs[UPDI_CS_CTRLA] & (1 << UPDI_CTRLA_RSD_BIT)? 0: respond(e, &a, 1);
+}
+
+static int getval(Emu *e, uint32_t *val, int n) {
+  uint8_t b[4];
+  int rc;
+
+  if((rc = emu_getn(e, b, n, TIMEOUT_MS)) < 0)
+    return rc;
+  *val = 0;
+  for(int i = 0; i < n; i++)
+    *val |= (uint32_t) b[i] << 8*i;
+
+  return 0;
+}
+
+// One UPDI instruction following SYNC
+static int updi_instruction(Emu *e) {
+  uint8_t out[1024];
+  uint32_t addr, val;
+  int c, rc, n;
+
+  if((c = emu_getc(e, TIMEOUT_MS)) < 0)
+    return c;
+  e->sess.ncmds++;
+
+  int asize = ((c >> 2) & 3) + 1, dsize = (c & 3) + 1;
+  switch(c & 0xe0) {
+  case UPDI_LDS:
+    if((rc = getval(e, &addr, asize)) < 0)
+      return rc;
+    for(int i = 0; i < dsize && i < 2; i++)
+      out[i] = tgt_read(e, addr+i);
+    return respond(e, out, dsize > 2? 2: dsize);
+
+  case UPDI_STS:
+    if((rc = getval(e, &addr, asize)) < 0 || (rc = ack(e)) < 0)
+      return rc;
+    if((rc = getval(e, &val, dsize > 2? 2: dsize)) < 0)
+      return rc;
+    for(int i = 0; i < dsize && i < 2; i++)
+      tgt_write(e, addr+i, val >> 8*i);
+    return ack(e);
+
+  case UPDI_LD:
+    if((c & 0x0c) == UPDI_PTR_ADDRESS) {
+      for(int i = 0; i < dsize; i++)
+        out[i] = tg.ptr >> 8*i;
+      return respond(e, out, dsize);
+    }
+    n = 0;
+    turnaround(e, tg.repeat+1);
+    for(int r = tg.repeat; r >= 0; r--) {
+      for(int i = 0; i < dsize && i < 2; i++)
+        out[n++] = tgt_read(e, tg.ptr+i);
+      if((c & 0x0c) == UPDI_PTR_INC)
+        tg.ptr += dsize > 2? 2: dsize;
+      if(n > (int) sizeof out - 2 || r == 0) {
+        if((rc = emu_send(e, out, n)) < 0)
+          return rc;
+        n = 0;
+      }
+    }
+    tg.repeat = 0;
+    return 0;
+
+  case UPDI_ST:
+    if((c & 0x0c) == UPDI_PTR_ADDRESS) {
+      if((rc = getval(e, &tg.ptr, dsize)) < 0)
+        return rc;
+      return ack(e);
+    }
+    for(int r = tg.repeat; r >= 0; r--) {
+      if((rc = getval(e, &val, dsize > 2? 2: dsize)) < 0) {
+        tg.repeat = 0;
+        return rc;
+      }
+      for(int i = 0; i < dsize && i < 2; i++)
+        tgt_write(e, tg.ptr+i, val >> 8*i);
+      if((c & 0x0c) == UPDI_PTR_INC)
+        tg.ptr += dsize > 2? 2: dsize;
+      if((rc = ack(e)) < 0)
+        return rc;
+    }
+    tg.repeat = 0;
+    return 0;
+
+  case UPDI_LDCS:
+    out[0] = cs_read(e, c & 0x0f);
+    return respond(e, out, 1);
+
+  case UPDI_STCS:
+    if((rc = getval(e, &val, 1)) < 0)
+      return rc;
+    cs_write(e, c & 0x0f, val);
+    return 0;
+
+  case UPDI_REPEAT:
+    if((rc = getval(e, &val, (c & 3) == UPDI_REPEAT_WORD? 2: 1)) < 0)
+      return rc;
+    tg.repeat = val;
+    return 0;
+
+  case UPDI_KEY:
+    n = 8 << (c & 3);
+    if(c & UPDI_KEY_SIB) {
+      memset(out, 0, n);
+      memcpy(out, tg.sib, n < 32? n: 32);
+      return respond(e, out, n);
+    }
+    if((rc = emu_getn(e, out, n, TIMEOUT_MS)) < 0)
+      return rc;
+    if(n == 8) {                // Keys are sent LSB first, ie, reversed
+      static const struct { const char *key; int bit; } keys[] = {
+        {UPDI_KEY_NVM, UPDI_ASI_KEY_STATUS_NVMPROG},
+        {UPDI_KEY_CHIPERASE, UPDI_ASI_KEY_STATUS_CHIPERASE},
+        {UPDI_KEY_UROW, UPDI_ASI_KEY_STATUS_UROWWRITE},
+      };
+      for(size_t k = 0; k < sizeof keys/sizeof *keys; k++) {
+        int i;
+        for(i = 0; i < 8 && out[i] == (uint8_t) keys[k].key[7-i]; i++)
+          continue;
+        if(i == 8) {
+          emu_log(e, "key %s\n", keys[k].key);
+          tg.keys |= 1 << keys[k].bit;
+        }
+      }
+    }
+    return 0;
+  }
+
+  return 0;
+}
+
+// serialupdi: wait for BREAK or SYNC and execute the instruction that follows
+static int serialupdi_cmd(Emu *e) {
+  int c = emu_getc(e, -1);
+
+  if(c < 0)
+    return c;
+  if(c == UPDI_BREAK) {         // Reset the UPDI link layer
+    emu_log(e, "break\n");
+    tg.disabled = 0;
+    tg.repeat = 0;
+    tg.cs[UPDI_CS_CTRLA] = tg.cs[UPDI_CS_CTRLB] = 0;
+    return 0;
+  }
+  if(tg.disabled)
+    return 0;
+  if(emu_baud(e) > max_baud()) { // Target cannot make sense of bytes at this rate
+    emu_log(e, "%ld baud too fast for UPDI clock\n", emu_baud(e));
+    return 0;
+  }
+  if(c != UPDI_PHY_SYNC) {
+    emu_log(e, "expected SYNC but got 0x%02x\n", c);
+    return 0;
+  }
+
+  return updi_instruction(e);
+}
+
+/*
+ * jtag2updi: JTAGICE mkII frames; the bridge executes memory operations on
+ * the target with the NVM command sequences that serialupdi would use
+ */
+
+static void bridge_traffic(Emu *e, long nbytes) {
+  emu_busy(e, nbytes*12e6/BRIDGE_BAUD);
+}
+
+static void bridge_wait(Emu *e) {
+  uint64_t until = tg.fbusy > tg.eebusy? tg.fbusy: tg.eebusy;
+
+  nvm_stall(e, until);
+  bridge_traffic(e, 8);
+}
+
+static void bridge_cmd(Emu *e, uint8_t cmd) {
+  bridge_wait(e);
+  tgt_write(e, tg.up->nvmctrl + Vx_CTRLA, cmd);
+  bridge_traffic(e, 7);
+}
+
+static void bridge_store(Emu *e, uint32_t addr, const uint8_t *data, int n) {
+  for(int i = 0; i < n; i++)
+    tgt_write(e, addr+i, data[i]);
+  bridge_traffic(e, 2L*n + 10);
+}
+
+static void bridge_write(Emu *e, uint8_t mtype, uint32_t addr, const uint8_t *data, int n) {
+  uint32_t off;
+  Region r = region(addr, &off);
+  int nvm = tg.up->nvm, pagewise = nvm == 3 || nvm == 5;
+
+  if(r == R_DATA || r == R_NONE || r == R_NVMCTRL) {
+    bridge_store(e, addr, data, n);
+    return;
+  }
+  if(nvm == 0) {
+    if(r == R_FUSE || r == R_LOCK) {
+      for(int i = 0; i < n; i++) {
+        uint8_t a[3] = {(addr+i) & 0xff, (addr+i) >> 8, data[i]};
+        bridge_wait(e);
+        bridge_store(e, tg.up->nvmctrl + V0_ADDR, a, 2);
+        bridge_store(e, tg.up->nvmctrl + V0_DATA, a+2, 1);
+        bridge_cmd(e, V0_WFU);
+      }
+    } else {
+      bridge_cmd(e, V0_PBC);
+      bridge_store(e, addr, data, n);
+      bridge_cmd(e, r == R_FLASH? V0_WP: V0_ERWP);
+    }
+  } else if(r == R_FLASH || (r == R_USERROW && !pagewise)) {
+    if(pagewise) {
+      bridge_cmd(e, Vx_FLPBC);
+      bridge_store(e, addr, data, n);
+      bridge_cmd(e, Vx_FLPW);
+    } else {
+      if(r == R_USERROW) {
+        bridge_cmd(e, Vx_FLPER);
+        bridge_store(e, addr, data, 1);
+        bridge_cmd(e, Vx_NOCMD);
+      }
+      bridge_cmd(e, Vx_FLWR);
+      bridge_store(e, addr, data, n);
+    }
+    bridge_cmd(e, Vx_NOCMD);
+  } else {
+    if(pagewise) {
+      bridge_cmd(e, Vx_FLPBC);
+      bridge_store(e, addr, data, n);
+      bridge_cmd(e, r == R_USERROW? Vx_FLPERW: Vx_EEPERW);
+    } else {
+      bridge_cmd(e, Vx_EEERWR);
+      bridge_store(e, addr, data, n);
+    }
+    bridge_cmd(e, Vx_NOCMD);
+  }
+  bridge_wait(e);
+  (void) mtype;
+}
+
+static int mkii_reply(Emu *e, uint16_t seq, const uint8_t *body, int n) {
+  uint8_t buf[1024+16];
+
+  buf[0] = MESSAGE_START;
+  buf[1] = seq;
+  buf[2] = seq >> 8;
+  buf[3] = n;
+  buf[4] = n >> 8;
+  buf[5] = n >> 16;
+  buf[6] = n >> 24;
+  buf[7] = TOKEN;
+  memcpy(buf+8, body, n);
+  crcappend(buf, n+8);
+
+  return emu_send(e, buf, n+10);
+}
+
+static uint32_t b4(const uint8_t *p) {
+  return p[0] | p[1]<<8 | p[2]<<16 | (uint32_t) p[3]<<24;
+}
+
+// One JTAGICE mkII message as understood by jtag2updi
+static int jtag2updi_cmd(Emu *e) {
+  uint8_t msg[1024+16], ans[1024+16];
+  uint32_t len, addr, n;
+  uint16_t seq;
+  int c, rc, alen = 1;
+
+  do {                          // Wait for message start
+    if((c = emu_getc(e, -1)) < 0)
+      return c;
+  } while(c != MESSAGE_START);
+
+  msg[0] = c;
+  if((rc = emu_getn(e, msg+1, 7, TIMEOUT_MS)) < 0)
+    return rc;
+  seq = msg[1] | msg[2]<<8;
+  len = b4(msg+3);
+  if(msg[7] != TOKEN || len < 1 || len > sizeof msg - 10) {
+    emu_log(e, "bad frame header\n");
+    return 0;
+  }
+  if((rc = emu_getn(e, msg+8, len+2, TIMEOUT_MS)) < 0)
+    return rc;
+  if(!crcverify(msg, len+10)) {
+    emu_log(e, "CRC error\n");
+    return 0;
+  }
+  e->sess.ncmds++;
+
+  uint8_t *body = msg+8;
+  emu_log(e, "command 0x%02x\n", body[0]);
+  ans[0] = RSP_OK;
+  switch(body[0]) {
+  case CMND_GET_SIGN_ON: {      // Firmware 6.00 as reported by jtag2updi
+    static const uint8_t signon[] = {RSP_SIGN_ON, 1, 0xff, 0x00, 0x06, 1, 0xff, 0x00, 0x06, 1,
+      0x55, 0x50, 0x44, 0x49, 0x45, 0x4d, 'J', 'T', 'A', 'G', 'I', 'C', 'E', ' ', 'm', 'k', 'I', 'I', 0};
+    memcpy(ans, signon, sizeof signon);
+    alen = sizeof signon;
+    break;
+  }
+  case CMND_GET_PARAMETER:
+    ans[0] = RSP_PARAMETER;
+    ans[1] = ans[2] = 0;
+    if(len > 1 && body[1] == PAR_OCD_VTARGET)
+      ans[1] = 5000 & 0xff, ans[2] = 5000 >> 8;
+    alen = 3;
+    break;
+  case CMND_ENTER_PROGMODE:     // Bridge sends NVMProg key and toggles reset
+    bridge_traffic(e, 30);
+    tg.locked = !is_unlocked();
+    if(tg.locked)
+      ans[0] = RSP_ILLEGAL_MCU_STATE;
+    else
+      tg.progmode = 1;
+    break;
+  case CMND_LEAVE_PROGMODE:
+    bridge_traffic(e, 10);
+    tg.progmode = 0;
+    break;
+  case CMND_XMEGA_ERASE:
+    if(len >= 6 && body[1] == XMEGA_ERASE_CHIP) {
+      if(tg.locked) {           // Chip erase key
+        bridge_traffic(e, 30);
+        chip_erase(e);
+      } else
+        bridge_cmd(e, tg.up->nvm? Vx_CHER: V0_CHER);
+      if(tg.up->nvm)
+        bridge_cmd(e, Vx_NOCMD);
+      bridge_wait(e);
+    } else if(len >= 6 && body[1] == XMEGA_ERASE_EEPROM) {
+      bridge_cmd(e, tg.up->nvm? Vx_EECHER: V0_EEER);
+      if(tg.up->nvm)
+        bridge_cmd(e, Vx_NOCMD);
+      bridge_wait(e);
+    }
+    break;
+  case CMND_READ_MEMORY:
+    if(len < 10) {
+      ans[0] = RSP_ILLEGAL_PARAMETER;
+      break;
+    }
+    n = b4(body+2);
+    addr = b4(body+6) & 0xffffff; // UPDI has 24-bit addresses
+    if(n > sizeof ans - 1) {
+      ans[0] = RSP_ILLEGAL_MEMORY_RANGE;
+      break;
+    }
+    ans[0] = RSP_MEMORY;
+    for(uint32_t i = 0; i < n; i++)
+      ans[1+i] = tgt_read(e, addr+i);
+    bridge_traffic(e, n + 10);
+    alen = n+1;
+    break;
+  case CMND_WRITE_MEMORY:
+    if(len < 10 || b4(body+2) > len-10) {
+      ans[0] = RSP_ILLEGAL_PARAMETER;
+      break;
+    }
+    bridge_write(e, body[1], b4(body+6) & 0xffffff, body+10, b4(body+2));
+    break;
+  case CMND_SIGN_OFF:
+    tg.progmode = 0;
+    if((rc = mkii_reply(e, seq, ans, 1)) < 0)
+      return rc;
+    emu_session_end(e);
+    return 0;
+  default:                      // Parameters, device descriptor, sync, reset, go: acknowledge
+    break;
+  }
+
+  return mkii_reply(e, seq, ans, alen);
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+    "Usage: %s [options]\n"
+    "Options:\n"
+    "  -c <protocol>  serialupdi (default) or jtag2updi\n"
+    "  -p <part>      Emulated part, default m4809\n"
+    "  -b <baud>      Pace line at <baud>, 0 for no pacing; default follows the port rate\n"
+    "  -w <us>        Flash page write time, default depends on the NVM version\n"
+    "  -e <us>        EEPROM write time per page (NVM v0, v3, v5) or byte (v2, v4)\n"
+    "  -E <us>        Chip erase time, default depends on the NVM version\n"
+    "  -L             Start with a locked device\n"
+    "  -l <path>      Create symlink <path> to the pty slave\n"
+    "  -v             Log each instruction to stderr\n"
+    "Parts:\n", name);
+  list_parts();
+}
+
+int main(int argc, char **argv) {
+  Emu emu = {.baud = -1, .page_us = -1, .eebyte_us = -1, .erase_us = -1};
+  Protocol proto = P_SERIALUPDI;
+  const char *partname = "m4809";
+  const Updi_part *part;
+  int c, locked = 0;
+
+  while((c = getopt(argc, argv, "c:p:b:w:e:E:Ll:vh")) != -1) {
+    switch(c) {
+    case 'c':
+      if(!strcmp(optarg, "serialupdi"))
+        proto = P_SERIALUPDI;
+      else if(!strcmp(optarg, "jtag2updi"))
+        proto = P_JTAG2UPDI;
+      else {
+        fprintf(stderr, "unknown protocol %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'p':
+      partname = optarg;
+      break;
+    case 'b':
+      emu.baud = strtol(optarg, NULL, 0);
+      break;
+    case 'w':
+      emu.page_us = strtol(optarg, NULL, 0);
+      break;
+    case 'e':
+      emu.eebyte_us = strtol(optarg, NULL, 0);
+      break;
+    case 'E':
+      emu.erase_us = strtol(optarg, NULL, 0);
+      break;
+    case 'L':
+      locked = 1;
+      break;
+    case 'l':
+      emu.link = optarg;
+      break;
+    case 'v':
+      emu.verbose++;
+      break;
+    default:
+      usage(argv[0]);
+      return c != 'h';
+    }
+  }
+
+  if(!(part = locate_part(partname))) {
+    fprintf(stderr, "unknown part %s\n", partname);
+    usage(argv[0]);
+    return 1;
+  }
+
+  if(proto == P_SERIALUPDI) {   // 8E2 on a single wire
+    emu.framebits = 12;
+    emu.echo = 1;
+  } else                        // jtag2updi bridge buffers frames while busy
+    emu.rxbuffered = 1;
+  if(emu_init(&emu, &part->p) < 0 || emu_open_pty(&emu) < 0)
+    return 1;
+  init_target(&emu, part, locked);
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  printf("%s\n", emu.slave);
+  fflush(stdout);
+
+  while(!emu_quit) {
+    int rc = proto == P_JTAG2UPDI? jtag2updi_cmd(&emu): serialupdi_cmd(&emu);
+    if(rc == EMU_QUIT || rc == -1)
+      break;
+  }
+
+  emu_report(&emu);
+  emu_close(&emu);
+
+  return 0;
+}